@@ -0,0 +1,23 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// A bump-pointer stack allocator working on a caller-provided buffer.
+// Allocation is a pointer increment and deallocation is a reset of the bump pointer to an earlier
+// mark, so callers with stack-like allocation patterns (such as the search, which frees everything
+// a node allocated when the node exits) avoid malloc/free entirely.
+//
+// Do not use these members directly. Use the arena_ functions.
+struct Arena {
+    unsigned char *buf;  // The (aligned) start of the backing buffer
+    size_t size;         // Usable size of the backing buffer in bytes
+    size_t used;         // Current bump offset into the buffer
+};
+
+void arena_init(struct Arena *arena, unsigned char *buf, size_t size);
+void *arena_alloc(struct Arena *arena, size_t size);
+size_t arena_mark(const struct Arena *arena);
+void arena_release(struct Arena *arena, size_t mark);
+
+#endif /* ARENA_H */
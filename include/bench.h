@@ -0,0 +1,12 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+
+// Offline search drivers for the headless build: a deterministic fixed-depth benchmark over a
+// built-in position set, and a streaming EPD test-suite runner. See bench.c.
+
+void bench_run(int depth);
+bool epd_run(const char *path, int depth);
+
+#endif /* BENCH_H */
@@ -0,0 +1,68 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <chess.h>
+#include <stdint.h>
+
+// A Bitboard stores one bit per board square, with bit (rank * 8 + file) representing the square
+// at {file, rank} (so bit 0 is the top left square from white's POV, matching BoardPos).
+// The GameState keeps a set of occupancy bitboards in sync with the board array (see chess.h),
+// which the move generator and attack checks use instead of walking rays square by square.
+
+// Returns the bit index of a position
+static inline int bb_square(struct BoardPos pos) { return pos.rank * 8 + pos.file; }
+
+// Returns a bitboard with only the bit for square index `sq` set
+static inline Bitboard bb_from_square(int sq) { return 1ULL << sq; }
+
+// Returns a bitboard with only the bit for `pos` set
+static inline Bitboard bb_from_pos(struct BoardPos pos) { return bb_from_square(bb_square(pos)); }
+
+// Returns the position of square index `sq`
+static inline struct BoardPos bb_to_pos(int sq) { return BoardPos(sq % 8, sq / 8); }
+
+// Returns a bitboard with every square of `file` set
+static inline Bitboard bb_file(int file) { return 0x0101010101010101ULL << file; }
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+// Returns the index of the least significant set bit. `bb` must be non-zero.
+static inline int bb_scan_forward(Bitboard bb) {
+    unsigned long idx;
+    _BitScanForward64(&idx, bb);
+    return (int)idx;
+}
+
+// Returns the index of the most significant set bit. `bb` must be non-zero.
+static inline int bb_scan_reverse(Bitboard bb) {
+    unsigned long idx;
+    _BitScanReverse64(&idx, bb);
+    return (int)idx;
+}
+
+// Returns the number of set bits
+static inline int bb_popcount(Bitboard bb) { return (int)__popcnt64(bb); }
+#else
+// Returns the index of the least significant set bit. `bb` must be non-zero.
+static inline int bb_scan_forward(Bitboard bb) { return __builtin_ctzll(bb); }
+
+// Returns the index of the most significant set bit. `bb` must be non-zero.
+static inline int bb_scan_reverse(Bitboard bb) { return 63 - __builtin_clzll(bb); }
+
+// Returns the number of set bits
+static inline int bb_popcount(Bitboard bb) { return __builtin_popcountll(bb); }
+#endif
+
+void bitboard_init();
+Bitboard bb_knight_attacks(int sq);
+Bitboard bb_king_attacks(int sq);
+Bitboard bb_pawn_attacks(int sq, enum Player player);
+Bitboard bb_pawn_front_span(int sq, enum Player player);
+Bitboard bb_rook_attacks(int sq, Bitboard occupancy);
+Bitboard bb_bishop_attacks(int sq, Bitboard occupancy);
+Bitboard bb_queen_attacks(int sq, Bitboard occupancy);
+Bitboard bb_between(int a, int b);
+Bitboard bb_line(int a, int b);
+
+#endif /* BITBOARD_H */
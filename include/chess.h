@@ -6,6 +6,10 @@
 
 typedef uint64_t ZobristHash;
 
+// One bit per board square, bit (rank * 8 + file) representing the square at {file, rank}.
+// See bitboard.h.
+typedef uint64_t Bitboard;
+
 // Each chess piece type is assigned a unique value which is used in the board to identify pieces
 enum PieceType {
     Empty = 0,
@@ -19,12 +23,6 @@ enum PieceType {
 
 enum Player { WhitePlayer = 0, BlackPlayer = 1 };
 
-// Each piece on the board has a type and a player
-struct Piece {
-    enum PieceType type;
-    enum Player player;
-};
-
 #ifdef __GNUC__
 #define _PACK( __Declaration__ ) __Declaration__ __attribute__((__packed__))
 #endif
@@ -33,6 +31,16 @@ struct Piece {
 #define _PACK( __Declaration__ ) __pragma( pack(push, 1) ) __Declaration__ __pragma( pack(pop))
 #endif
 
+// Each piece on the board has a type and a player.
+// The fields are single bytes rather than full enum ints so the board is 128 bytes instead of
+// 512 and a GameState spans far fewer cache lines on the search hot path; the enum constants
+// still assign and compare as usual through the integer promotions. A zeroed Piece is an empty
+// square (Empty is 0), which clear_board relies on.
+_PACK(struct Piece {
+    uint8_t type;    // enum PieceType
+    uint8_t player;  // enum Player
+});
+
 // Stores representation of a position on the board.
 // {file 0, rank 0} is the top left of the board (from whites POV)
 // and {file 7, rank 7} is the bottom right (from whites POV)
@@ -51,6 +59,35 @@ struct Move {
     struct BoardPos to;
 };
 
+// Number of slots in the GameState hash history ring. Repetition scans look at most 99 plies back
+// (the fifty-move rule draws the game at 100 halfmoves without a capture or pawn move), so any
+// power of two above that is enough; older slots are overwritten harmlessly as the ring wraps.
+#define HASH_HISTORY_MAX 128
+
+// Records everything needed to reverse a move made with make_move_undoable(),
+// so the search can mutate a single GameState in place instead of copying it
+// at every node.
+// Filled in by make_move_undoable() and consumed by unmake_move().
+struct MoveUndo {
+    struct Move move;               // The move which was made
+    struct Piece moved_piece;       // The piece which moved (before any promotion)
+    struct Piece captured_piece;    // The captured piece, or Empty if the move was not a capture
+    struct BoardPos captured_pos;   // The square the captured piece stood on (differs from `to` for en passant)
+    int8_t captured_list_idx;       // Index of the captured piece in its piece list, or -1
+    int8_t enpassant_target_white;  // Previous en passant target files
+    int8_t enpassant_target_black;  //
+    bool white_castlert_left;       // Previous castling rights
+    bool white_castlert_right;      //
+    bool black_castlert_left;       //
+    bool black_castlert_right;      //
+    struct BoardPos white_king;     // Previous king positions
+    struct BoardPos black_king;     //
+    bool white_king_in_check;       // Previous check statuses
+    bool black_king_in_check;       //
+    ZobristHash hash;               // Previous zobrist hash
+    int halfmove_clock;             // Previous halfmove clock
+};
+
 // The GameState struct stores all information about an ongoing game that is used
 // by the engine.
 // It can be initialised to the starting state using init_gamestate()
@@ -71,10 +108,28 @@ struct GameState {
     struct BoardPos piece_list_white[16];  // A list of the positions of all white pieces
     struct BoardPos piece_list_black[16];  // A list of the positions of all black pieces
     ZobristHash hash;                      // The zobrist hash of the state
+    Bitboard bb_type[7];                   // Square occupancy by piece type, indexed by enum PieceType
+                                           // (bb_type[Empty] is unused). Kept in sync by put_piece.
+    Bitboard bb_player[2];                 // Square occupancy by player, indexed by enum Player
+    int material;                          // Sum of white piece values minus black piece values.
+                                           // Kept in sync by put_piece, so the evaluation does not
+                                           // have to rescan the piece lists at every leaf.
+    int psq;                               // Sum of white square bonuses minus black square bonuses,
+                                           // also kept in sync by put_piece.
+    int halfmove_clock;                    // Halfmoves since the last capture or pawn move, for the
+                                           // fifty-move rule. Also bounds repetition scans, as no
+                                           // position before an irreversible move can repeat.
+    ZobristHash hash_history[HASH_HISTORY_MAX];  // Ring of the hashes of earlier positions, the
+                                           // position before ply n at index n % HASH_HISTORY_MAX.
+                                           // Written by make_move, read by the repetition check.
 };
 
 extern const struct BoardPos NULL_BOARDPOS;
 
+// The value of each piece type, indexed by (piece_type - 1).
+// E.g. the value of a queen is greater than that of a pawn as the queen is much more powerful.
+extern const int PIECE_VALUES[6];
+
 struct BoardPos BoardPos(int8_t file, int8_t rank);
 bool boardpos_eq(struct BoardPos a, struct BoardPos b);
 struct BoardPos boardpos_add(struct BoardPos a, struct BoardPos b);
@@ -11,15 +11,28 @@
 #define WINDOW_WIDTH 896
 #define WINDOW_HEIGHT 504
 
-// The size of the transposition table
-#define TRANSPOSITION_TABLE_SIZE 1048576
+// The default size of the transposition table in megabytes. The table can be resized at runtime
+// (tptable_resize), e.g. from the UCI Hash option.
+#define TPTABLE_DEFAULT_MB 256
 
 // The board square background colours, hex RGBA
 #define LIGHT_SQUARE_COLOUR 0xfffedbff
 #define DARK_SQUARE_COLOUR 0x38a3beff
 
-// The maximum number of seconds allowed for move generation threads per move.
-#define MAX_MOVEGEN_SEARCH_TIME 3
+// The time budget for move generation per move, in milliseconds.
+// No new deepening iteration is started after the soft limit; the iteration in progress is
+// aborted at the hard limit (see timeman.h).
+#define MOVEGEN_SOFT_TIME_MS 2000
+#define MOVEGEN_HARD_TIME_MS 3000
+
+// The time budget of a ponder search (searching the predicted human reply during their turn).
+// Effectively unlimited: the search is re-armed to the normal budget on a ponder hit and aborted
+// on a miss, so the cap only stops an abandoned game from burning CPU forever.
+#define MOVEGEN_PONDER_TIME_MS 600000
+
+// The number of search nodes visited between checks of the search deadline, so the clock is read
+// once per batch instead of once per node.
+#define SEARCH_TIME_CHECK_NODES 4096
 
 // The maximum movegen search depth attempted
 // Higher values will increase memory usage.
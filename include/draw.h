@@ -6,5 +6,6 @@
 void load_textures();
 void unload_textures();
 void draw_board(struct GameState *state);
+void invalidate_board_cache();
 
 #endif /* DRAW_H */
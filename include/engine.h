@@ -4,7 +4,7 @@
 #include <chess.h>
 #include <stdbool.h>
 #include <threadpool.h>
-#include <time.h>
+#include <timeman.h>
 
 // The maximum number of legal moves a single piece can have
 #define PIECE_LEGAL_MOVES_MAX 27
@@ -13,12 +13,45 @@
 // Used for estimating who will win
 #define ROUGH_MAX_POSITION_VALUE 4000
 
+// The result of a search, read from the completion mailbox with search_result_get().
+struct SearchResult {
+    struct Move best_move;  // The best root move of the deepest completed iteration
+    int value;              // Its value, relative to the player to move
+    int depth;              // The iteration depth (CHAR_MAX for an opening book move)
+};
+
+// Counters collected by the search, for diagnosing the effect of tuning changes.
+// Each search thread counts into a private struct on the hot path (no shared writes per node);
+// the workers fold their counts into a shared total when their deepening loop ends, and
+// search_stats_get() returns the totals of the last completed search.
+struct SearchStats {
+    uint64_t nodes;              // Negamax nodes visited
+    uint64_t qnodes;             // Quiescence nodes visited
+    uint64_t tt_probes;          // Transposition table probes made by negamax
+    uint64_t tt_hits;            // Probes which found the position, at any depth
+    uint64_t tt_cutoffs;         // Probes which terminated the node without a move loop
+    uint64_t beta_cutoffs;       // Nodes which failed high
+    uint64_t beta_cutoffs_first; // Nodes which failed high on the first move searched,
+                                 // a measure of move ordering quality
+    int depth;                   // Deepest root iteration completed by the main worker
+    int64_t elapsed_ms;          // Wall time of the search
+};
+
 bool is_piece_attacked(struct GameState *state, struct BoardPos attackee_pos, enum Player attacker);
 bool is_move_legal(struct GameState *state, struct Move move);
 void make_move(struct GameState *state, struct Move move, bool calculate_hash);
+void make_move_undoable(struct GameState *state, struct Move move, struct MoveUndo *undo, bool calculate_hash);
+void unmake_move(struct GameState *state, const struct MoveUndo *undo);
 bool is_player_checkmated(struct GameState *state, enum Player player);
-void generate_move(struct GameState *state, struct ThreadPool *pool, time_t start_time);
+void generate_move(struct GameState *state, struct ThreadPool *pool, struct TimeManager *tm);
+void generate_move_timed(struct GameState *state, struct ThreadPool *pool, struct TimeManager *tm,
+                         int64_t soft_limit_ms, int64_t hard_limit_ms, struct TaskBatch *batch);
+void search_fixed_depth(struct GameState *state, int max_depth, struct SearchResult *result_out);
 bool is_stalemate(struct GameState *state);
 int position_value(struct GameState *state);
+uint64_t perft(struct GameState *state, int depth);
+uint64_t perft_parallel(struct GameState *state, int depth, struct ThreadPool *pool);
+struct SearchStats search_stats_get();
+bool search_result_get(ZobristHash root_hash, struct SearchResult *out);
 
 #endif /* ENGINE_H */
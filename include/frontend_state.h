@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <threadpool.h>
+#include <timeman.h>
 
 // Frontend state stores information needed by the frontend
 // to the chess implementation (the UI, input handlers, etc)
@@ -20,11 +21,24 @@ struct FrontendState {
     int move_log_line_chars;            // The number of chars on the current line of the move log
     int winner;  // The winner of the game or -1 if it is ongoing. 0, 1, 2 for white win, black win and draw
     const char *message_box;  // The content of a message box to be displayed on screen, NULL if no message.
-    time_t movegen_started;   // The time at which move generation was last started, or 0.
+    bool movegen_running;     // Whether move generation is currently running
+    struct TimeManager movegen_timeman;  // The time budget of the running move generation; its
+                                         // stop flag is set when the generated move is ready
+
+    // Pondering: after the engine moves, the predicted human reply is searched speculatively
+    // during their turn (see start_ponder in main.c)
+    bool ponder_running;                // Whether a ponder search is running
+    bool ponder_hit;                    // The human played the predicted reply, so the ponder
+                                        // search was promoted to the real search
+    struct Move ponder_move;            // The human reply the ponder search assumed
+    struct TimeManager ponder_timeman;  // The ponder search's budget. Separate from
+                                        // movegen_timeman so aborting a wrong guess can never
+                                        // race with the next real search
 
     // Debug settings
     bool debug_allow_illegal_moves;  // Disables legality checking of human moves
     bool debug_copy_on_move;         // Instead of moving pieces copy them
+    bool debug_show_search_stats;    // Overlay the statistics of the last search on the board
 };
 
 // There is a single static instance of FrontendState for the entire program,
@@ -0,0 +1,10 @@
+#ifndef KPK_H
+#define KPK_H
+
+#include <chess.h>
+#include <stdbool.h>
+
+void kpk_init();
+bool kpk_probe(struct BoardPos white_king, struct BoardPos black_king, struct BoardPos pawn, bool white_to_move);
+
+#endif /* KPK_H */
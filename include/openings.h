@@ -2,16 +2,18 @@
 #define OPENINGS_H
 
 #include <chess.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <zobrist.h>
 
 struct OpeningItem {
     ZobristHash hash;
-    struct Move* moves;
+    struct Move moves[UINT8_MAX];
     uint8_t moves_count;
 };
 
 void init_opening_book();
 void deinit_opening_book();
-struct OpeningItem* find_opening_by_hash(ZobristHash hash);
+bool find_opening_by_hash(ZobristHash hash, struct OpeningItem* item_out);
 
 #endif /* OPENINGS_H */
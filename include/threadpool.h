@@ -10,6 +10,9 @@
 #include <threads.h>
 #endif
 
+// The capacity of the external submission inbox and of each worker's deque.
+// Submissions beyond these bounds block (inbox) or run on the submitting thread (deque) instead
+// of being dropped.
 #define THREADPOOL_QUEUE_SIZE 256
 
 #ifndef HAS_C11_CONCURRENCY
@@ -21,23 +24,50 @@ typedef struct {
 } cnd_t;
 typedef size_t atomic_size_t;
 typedef unsigned short atomic_ushort;
+typedef bool atomic_bool;
 #endif
 
-typedef bool (*TaskFunc)(void *);
+typedef void (*TaskFunc)(void *);
+
+// A group of tasks submitted together, used as a completion handle: the submitter can wait for
+// the whole batch with threadpool_wait, poll it with taskbatch_done, or cancel the tasks which
+// have not started yet with taskbatch_cancel.
+// Must be initialised with taskbatch_init before the first submit, and must outlive its tasks.
+struct TaskBatch {
+    atomic_size_t remaining;  // Tasks submitted but not yet finished (or skipped by a cancel)
+    atomic_bool cancelled;    // When set, workers complete the batch's queued tasks without
+                              // calling their functions
+};
 
 struct Task {
     TaskFunc func;
     void *arg;
+    struct TaskBatch *batch;  // The batch the task belongs to, or NULL
 };
 
+struct WSDeque;
+
+// A pool of persistent worker threads. Each worker owns a lock-free work-stealing deque
+// (Chase-Lev): it pushes and pops its own submissions at the bottom without synchronisation and
+// steals from the top of the other workers' deques when its own runs dry. Submissions from
+// threads outside the pool go through a mutex-protected inbox, which is only touched by workers
+// that have run out of deque work, so the old single lock around every dequeue is off the
+// steady-state path entirely.
+//
 // Do not use these members directly. Use the threadpool_ functions.
 struct ThreadPool {
-    mtx_t mutex;  // Guards queue, queue_front, queue_back, task_available
-    cnd_t task_available;
-    struct Task queue[THREADPOOL_QUEUE_SIZE];
-    size_t queue_front;  // Index of the next item to be dequeued, or THREADPOOL_QUEUE_SIZE
-    size_t queue_back;   // Index where the next enqueued item should be placed
-    atomic_size_t thread_count;
+    mtx_t mutex;           // Guards the inbox and the sleep/wake conditions
+    cnd_t task_available;  // Signalled when a task is submitted
+    cnd_t inbox_space;     // Signalled when the inbox makes room, for submit backpressure
+    cnd_t batch_finished;  // Broadcast when the last task of any batch finishes
+    struct Task inbox[THREADPOOL_QUEUE_SIZE];  // External submissions, drained by the workers
+    size_t inbox_front;                        // Index of the oldest inbox entry
+    size_t inbox_count;                        // Number of entries in the inbox
+    struct WSDeque *deques;                    // One work-stealing deque per worker
+    size_t worker_count;
+    atomic_size_t pending;       // Tasks submitted but not yet picked up by a worker
+    atomic_size_t thread_count;  // Workers still running, drained during shutdown
+    atomic_bool shutdown;
 };
 
 // Atomic ushort counter.
@@ -47,9 +77,14 @@ struct AtomicCounter {
 };
 
 struct ThreadPool *threadpool_init();
-void threadpool_enqueue(struct ThreadPool *pool, TaskFunc func, void *arg);
+void threadpool_submit(struct ThreadPool *pool, TaskFunc func, void *arg, struct TaskBatch *batch);
+void threadpool_wait(struct ThreadPool *pool, struct TaskBatch *batch);
+size_t threadpool_thread_count(struct ThreadPool *pool);
 void threadpool_deinit(struct ThreadPool *pool);
+void taskbatch_init(struct TaskBatch *batch);
+void taskbatch_cancel(struct TaskBatch *batch);
+bool taskbatch_done(struct TaskBatch *batch);
 struct AtomicCounter *acnt_init(unsigned short val);
 bool acnt_dec(struct AtomicCounter *counter);
 
-#endif /* THREADPOOL_H */
\ No newline at end of file
+#endif /* THREADPOOL_H */
@@ -0,0 +1,35 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <threadpool.h>
+
+// Manages the time budget of one search on a monotonic millisecond clock.
+// A search has two deadlines: no new deepening iteration is started after the soft deadline, and
+// the iteration in progress is aborted at the hard deadline. The stop flag is set when the search
+// finishes (or is told to finish early) and is a single atomic load to poll, so the frontend can
+// notice completion immediately instead of waiting for a whole-second boundary.
+//
+// Do not use these members directly. Use the timeman_ functions.
+struct TimeManager {
+    int64_t start_ms;          // Clock reading when the search started
+    int64_t soft_deadline_ms;  // Do not start a new deepening iteration at or after this time
+    int64_t hard_deadline_ms;  // Abort the search in progress at or after this time
+#ifdef HAS_C11_CONCURRENCY
+    atomic_bool stop;
+#else
+    bool stop;
+#endif
+};
+
+int64_t timeman_now_ms();
+void timeman_start(struct TimeManager *tm, int64_t soft_limit_ms, int64_t hard_limit_ms);
+void timeman_rearm(struct TimeManager *tm, int64_t soft_limit_ms, int64_t hard_limit_ms);
+int64_t timeman_elapsed_ms(const struct TimeManager *tm);
+bool timeman_soft_expired(const struct TimeManager *tm);
+bool timeman_hard_expired(const struct TimeManager *tm);
+void timeman_stop(struct TimeManager *tm);
+bool timeman_stopped(struct TimeManager *tm);
+
+#endif /* TIMEMAN_H */
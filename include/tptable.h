@@ -2,6 +2,8 @@
 #define TPTABLE_H
 
 #include <chess.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <zobrist.h>
 
 // For entries with an evaluation value, states whether the value is an upper bound, lower bound, or an exact value.
@@ -16,11 +18,22 @@ struct TranspositionEntry {
     enum EntryType type;
 };
 
+// An independent transposition table instance (see tptable.c). The tptable_ functions operate
+// on the instance selected on the calling thread with tptable_select, defaulting to a shared
+// instance allocated by tptable_init - single-engine targets never need to select anything.
+struct TPTable;
+
 struct TranspositionEntry tptable_get(ZobristHash hash);
 void tptable_put(struct TranspositionEntry entry);
 void tptable_clear();
-void tptable_init();
+void tptable_init(size_t size_mb);
 void tptable_deinit();
-void tptable_set_protected_hash(ZobristHash hash);
+struct TPTable *tptable_create(size_t size_mb);
+void tptable_destroy(struct TPTable *table);
+void tptable_select(struct TPTable *table);
+void tptable_resize(size_t size_mb);
+void tptable_new_search();
+bool tptable_save(const char *path);
+bool tptable_load(const char *path);
 
 #endif /* TPTABLE_H */
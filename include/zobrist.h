@@ -4,5 +4,9 @@
 #include <chess.h>
 
 ZobristHash hash_state(struct GameState *state);
+ZobristHash zobrist_toggle_piece(ZobristHash hash, struct Piece piece, struct BoardPos pos);
+ZobristHash zobrist_toggle_white_to_move(ZobristHash hash);
+ZobristHash zobrist_toggle_castlert(ZobristHash hash, enum Player player, bool left);
+ZobristHash zobrist_enpassant_part(struct GameState *state);
 
 #endif /* ZOBRIST_H */
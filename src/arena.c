@@ -0,0 +1,45 @@
+#include <arena.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// All allocations are rounded up to this alignment so any type can be stored.
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+// Initialises an arena on top of `buf`. The buffer is not owned by the arena and must outlive it.
+void arena_init(struct Arena *arena, unsigned char *buf, size_t size) {
+    // Align the base pointer so every allocation which is a multiple of the alignment stays
+    // aligned (the caller's buffer may be a plain char array with no particular alignment).
+    uintptr_t base = (uintptr_t)buf;
+    uintptr_t aligned = (base + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+
+    arena->buf = (unsigned char *)aligned;
+    arena->size = size - (aligned - base);
+    arena->used = 0;
+}
+
+// Allocates `size` bytes from the arena.
+// The arena's backing buffer is a fixed upper bound on its usage, so running out indicates a
+// sizing bug and exits rather than returning NULL.
+void *arena_alloc(struct Arena *arena, size_t size) {
+    size_t aligned_size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    if (arena->size - arena->used < aligned_size) {
+        puts("arena out of memory");
+        exit(EXIT_FAILURE);
+    }
+
+    void *out = arena->buf + arena->used;
+    arena->used += aligned_size;
+    return out;
+}
+
+// Returns a mark of the arena's current usage, to be passed to arena_release.
+size_t arena_mark(const struct Arena *arena) { return arena->used; }
+
+// Releases every allocation made since `mark` was taken.
+void arena_release(struct Arena *arena, size_t mark) {
+    assert(mark <= arena->used);
+    arena->used = mark;
+}
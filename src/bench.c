@@ -0,0 +1,256 @@
+// Offline search drivers for the headless chess-uci build, used to gate performance changes
+// with numbers instead of impressions.
+//
+// bench_run searches a fixed set of positions to a fixed depth and prints the total node count
+// as a signature. The searches run through search_fixed_depth (engine.c) on the calling thread,
+// so they visit exactly the same nodes on every run: a change which does not mean to alter the
+// search proves it by leaving the signature unchanged, and the node and time totals then measure
+// a genuine speedup. Nothing on this path consults rand() or the opening book (the GUI seeds
+// rand with the clock; the UCI build never seeds it), so the signature needs no fixed seed. It
+// does depend on the transposition table size, so compare signatures at the same Hash setting.
+//
+// epd_run streams a file of EPD records - one position per line, the first four FEN fields
+// followed by operations such as `bm Nf6; id "pos.01";` - searches each to the given depth and
+// scores the engine's move against the `bm` (best move) operands. The file is read one line at
+// a time, so suites of any size run in constant memory. fen_to_gamestate already stops at the
+// end of the four FEN fields it understands, so each line is handed to it whole.
+
+#include <bench.h>
+#include <chess.h>
+#include <engine.h>
+#include <fen.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <timeman.h>
+#include <tptable.h>
+
+// The depth used when the command gives none. Deep enough that move ordering and pruning
+// changes show up in the counts, shallow enough that the whole bench runs in a few seconds.
+#define BENCH_DEFAULT_DEPTH 7
+
+#define EPD_LINE_MAX 1024
+
+// The bench position set: the perft test positions (a mix of tactical and quiet middlegames)
+// plus two endgames, so the counts cover the evaluation's endgame terms too.
+static const char *BENCH_POSITIONS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1b1/2B1P1B1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/4k3/8/4P3/4K3/8/8 w - - 0 1",
+};
+
+// Searches a fixed set of positions to `depth` plies (the default depth if `depth` is not
+// positive) and prints the per-position node counts, the throughput, and the total node count
+// as the deterministic signature. The transposition table is cleared before every position so
+// the counts do not depend on what was searched before.
+void bench_run(int depth) {
+    if (depth <= 0) depth = BENCH_DEFAULT_DEPTH;
+
+    uint64_t total_nodes = 0;
+    int64_t total_ms = 0;
+
+    for (size_t i = 0; i < sizeof(BENCH_POSITIONS) / sizeof(BENCH_POSITIONS[0]); i++) {
+        struct GameState *state = fen_to_gamestate(BENCH_POSITIONS[i]);
+        if (state == NULL) {
+            printf("bench position %zu: invalid FEN\n", i + 1);
+            continue;
+        }
+
+        tptable_clear();
+
+        struct SearchResult result;
+        int64_t start_ms = timeman_now_ms();
+        search_fixed_depth(state, depth, &result);
+        int64_t elapsed_ms = timeman_now_ms() - start_ms;
+
+        struct SearchStats stats = search_stats_get();
+        uint64_t nodes = stats.nodes + stats.qnodes;
+        total_nodes += nodes;
+        total_ms += elapsed_ms;
+
+        printf("bench position %zu: %" PRIu64 " nodes in %lld ms\n", i + 1, nodes, (long long)elapsed_ms);
+
+        deinit_gamestate(state);
+    }
+
+    // Avoid dividing by zero on absurdly fast runs.
+    if (total_ms == 0) total_ms = 1;
+    printf("bench depth %d: %" PRIu64 " nodes in %lld ms (%" PRIu64 " nps)\n", depth, total_nodes,
+           (long long)total_ms, total_nodes * 1000 / (uint64_t)total_ms);
+    printf("bench signature: %" PRIu64 "\n", total_nodes);
+}
+
+// Parses one SAN move operand such as "Nf6", "Qxd5+", "exd5", "O-O" or "e8=Q" against the legal
+// moves of `state`, writing the matching move to `out`. Returns false if no legal move matches.
+// Check and annotation suffixes are ignored, as is the promotion piece: make_move always
+// promotes to a queen.
+static bool epd_parse_san(struct GameState *state, const char *san, struct Move *out) {
+    enum Player player = state->white_to_move ? WhitePlayer : BlackPlayer;
+    int8_t back_rank = player == WhitePlayer ? 7 : 0;
+
+    // Copy the operand, dropping the suffix characters which carry no move information.
+    char buf[16];
+    size_t len = 0;
+    for (const char *c = san; *c != '\0' && len < sizeof(buf) - 1; c++) {
+        if (*c != '+' && *c != '#' && *c != '!' && *c != '?') buf[len++] = *c;
+    }
+    buf[len] = '\0';
+
+    // Castling. The king move (two files towards the rook) is how make_move encodes it.
+    if (strcmp(buf, "O-O-O") == 0 || strcmp(buf, "0-0-0") == 0) {
+        *out = (struct Move){BoardPos(4, back_rank), BoardPos(2, back_rank)};
+        return is_move_legal(state, *out);
+    }
+    if (strcmp(buf, "O-O") == 0 || strcmp(buf, "0-0") == 0) {
+        *out = (struct Move){BoardPos(4, back_rank), BoardPos(6, back_rank)};
+        return is_move_legal(state, *out);
+    }
+
+    // Drop a promotion suffix such as "=Q".
+    if (len > 2 && buf[len - 2] == '=') len -= 2;
+    if (len < 2) return false;
+
+    // The last two characters are the destination square.
+    char file_char = buf[len - 2];
+    char rank_char = buf[len - 1];
+    if (file_char < 'a' || file_char > 'h' || rank_char < '1' || rank_char > '8') return false;
+    struct BoardPos to = BoardPos(file_char - 'a', 8 - (rank_char - '0'));
+
+    // A leading piece letter; its absence means a pawn move.
+    static const char PIECE_CHARS[7] = {'\0', 'K', 'Q', 'R', 'B', 'N', '\0'};
+    enum PieceType type = Pawn;
+    size_t i = 0;
+    for (int t = King; t <= Knight; t++) {
+        if (buf[0] == PIECE_CHARS[t]) {
+            type = t;
+            i = 1;
+            break;
+        }
+    }
+
+    // Any characters between the piece letter and the destination square disambiguate the
+    // origin by file and/or rank ("Nbd2", "R1e2", "exd5"); 'x' marks a capture and is skipped.
+    int dis_file = -1;
+    int dis_rank = -1;
+    for (; i < len - 2; i++) {
+        if (buf[i] == 'x') continue;
+        if (buf[i] >= 'a' && buf[i] <= 'h') {
+            dis_file = buf[i] - 'a';
+        } else if (buf[i] >= '1' && buf[i] <= '8') {
+            dis_rank = 8 - (buf[i] - '0');
+        } else {
+            return false;
+        }
+    }
+
+    // Find the legal move of the right piece to the destination square.
+    for (int sq = 0; sq < 64; sq++) {
+        struct BoardPos from = BoardPos(sq % 8, sq / 8);
+        struct Piece piece = get_piece(state, from);
+        if (piece.type != type || piece.player != player) continue;
+        if (dis_file != -1 && from.file != dis_file) continue;
+        if (dis_rank != -1 && from.rank != dis_rank) continue;
+
+        struct Move move = {from, to};
+        if (is_move_legal(state, move)) {
+            *out = move;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Streams the EPD file at `path`, searching every position to `depth` plies (the default depth
+// if `depth` is not positive) and scoring the engine's move against the `bm` operands. Prints a
+// line per position and the solved count, node total and throughput at the end. Returns false
+// if the file cannot be opened.
+bool epd_run(const char *path, int depth) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return false;
+
+    if (depth <= 0) depth = BENCH_DEFAULT_DEPTH;
+
+    int positions = 0;
+    int solved = 0;
+    uint64_t total_nodes = 0;
+    int64_t total_ms = 0;
+
+    char line[EPD_LINE_MAX];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        struct GameState *state = fen_to_gamestate(line);
+        if (state == NULL) {
+            printf("epd line %d: invalid position\n", line_number);
+            continue;
+        }
+
+        // Parse the `bm` operation, which may list several acceptable moves ("bm Nf6 Bd7;").
+        struct Move best_moves[8];
+        int best_move_count = 0;
+        char *bm = strstr(line, "bm ");
+        if (bm != NULL) {
+            for (char *op = strtok(bm + strlen("bm "), " ;");
+                 op != NULL && best_move_count < (int)(sizeof(best_moves) / sizeof(best_moves[0]));
+                 op = strtok(NULL, " ;")) {
+                if (!epd_parse_san(state, op, &best_moves[best_move_count++])) {
+                    best_move_count--;
+                    break;
+                }
+            }
+        }
+
+        tptable_clear();
+
+        struct SearchResult result;
+        int64_t start_ms = timeman_now_ms();
+        search_fixed_depth(state, depth, &result);
+        int64_t elapsed_ms = timeman_now_ms() - start_ms;
+
+        bool have_result = !boardpos_eq(result.best_move.from, NULL_BOARDPOS);
+
+        struct SearchStats stats = search_stats_get();
+        uint64_t nodes = stats.nodes + stats.qnodes;
+
+        positions++;
+        total_nodes += nodes;
+        total_ms += elapsed_ms;
+
+        bool correct = false;
+        for (int i = 0; have_result && i < best_move_count; i++) {
+            correct |= boardpos_eq(result.best_move.from, best_moves[i].from) &&
+                       boardpos_eq(result.best_move.to, best_moves[i].to);
+        }
+        if (correct) solved++;
+
+        char move_str[5] = "none";
+        if (have_result) {
+            boardpos_to_algn(result.best_move.from, move_str);
+            boardpos_to_algn(result.best_move.to, move_str + 2);
+            move_str[4] = '\0';
+        }
+
+        printf("epd line %d: %s %s, %" PRIu64 " nodes in %lld ms\n", line_number, move_str,
+               best_move_count == 0 ? "(no bm)" : correct ? "solved" : "missed", nodes, (long long)elapsed_ms);
+
+        deinit_gamestate(state);
+    }
+
+    fclose(file);
+
+    if (total_ms == 0) total_ms = 1;
+    printf("epd depth %d: solved %d/%d, %" PRIu64 " nodes in %lld ms (%" PRIu64 " nps)\n", depth, solved,
+           positions, total_nodes, (long long)total_ms, total_nodes * 1000 / (uint64_t)total_ms);
+
+    return true;
+}
@@ -0,0 +1,182 @@
+#include <bitboard.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Precomputed attack tables.
+// For the non-sliding pieces (knight, king, pawn) the table directly gives the attacked squares.
+// For the sliding pieces the classical ray approach is used: RAY_ATTACKS stores, for each
+// direction and square, the full ray to the edge of the board. The attacks given an occupancy are
+// found by locating the first blocker on the ray with a bit scan and removing the squares behind
+// it, so no per-square stepping is needed.
+static Bitboard RAY_ATTACKS[8][64];
+static Bitboard KNIGHT_ATTACKS[64];
+static Bitboard KING_ATTACKS[64];
+static Bitboard PAWN_ATTACKS[2][64];
+
+// PAWN_FRONT_SPAN[player][sq] holds every square on the pawn's own and adjacent files which is
+// strictly in front of it (towards its promotion rank). A pawn with no enemy pawn in its front
+// span is passed. Used by the evaluation's pawn structure terms.
+static Bitboard PAWN_FRONT_SPAN[2][64];
+
+// BETWEEN_BB[a][b] holds the squares strictly between two aligned squares (0 if not aligned), and
+// LINE_BB[a][b] the full line through two aligned squares out to the board edges, including both
+// squares (0 if not aligned). Used for check blocking masks and pin rays.
+static Bitboard BETWEEN_BB[64][64];
+static Bitboard LINE_BB[64][64];
+
+// The ray directions as {file, rank} deltas, ordered so that directions 0-3 move towards
+// increasing square indices (the first blocker is the least significant set bit) and directions
+// 4-7 towards decreasing indices (the first blocker is the most significant set bit).
+// Directions 0 and 2 and 4 and 6 are the rook directions, the others are the bishop directions.
+static const struct BoardPos RAY_DELTAS[8] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}, {-1, 0}, {1, -1}, {0, -1}, {-1, -1}};
+
+static const struct BoardPos KNIGHT_DELTAS[8] = {{2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {-1, 2}, {1, -2}, {-1, -2}};
+
+static bool tables_generated = false;
+
+// Generates the attack tables. Called once at startup; the attack getters also call it lazily so
+// the tables are available in unit tests which do not go through the normal startup path.
+void bitboard_init() {
+    if (tables_generated) return;
+
+    for (int sq = 0; sq < 64; sq++) {
+        struct BoardPos pos = bb_to_pos(sq);
+
+        // Rays for the sliding pieces, walking from the square to the edge of the board.
+        for (int dir = 0; dir < 8; dir++) {
+            RAY_ATTACKS[dir][sq] = 0;
+            struct BoardPos check = boardpos_add(pos, RAY_DELTAS[dir]);
+            while (!boardpos_eq(check, NULL_BOARDPOS)) {
+                RAY_ATTACKS[dir][sq] |= bb_from_pos(check);
+                check = boardpos_add(check, RAY_DELTAS[dir]);
+            }
+        }
+
+        // King attacks are the first step of each ray.
+        KING_ATTACKS[sq] = 0;
+        for (int dir = 0; dir < 8; dir++) {
+            struct BoardPos check = boardpos_add(pos, RAY_DELTAS[dir]);
+            if (!boardpos_eq(check, NULL_BOARDPOS)) KING_ATTACKS[sq] |= bb_from_pos(check);
+        }
+
+        // Knight attacks.
+        KNIGHT_ATTACKS[sq] = 0;
+        for (int i = 0; i < 8; i++) {
+            struct BoardPos check = boardpos_add(pos, KNIGHT_DELTAS[i]);
+            if (!boardpos_eq(check, NULL_BOARDPOS)) KNIGHT_ATTACKS[sq] |= bb_from_pos(check);
+        }
+
+        // Pawn attacks. White pawns attack towards rank 0 and black pawns towards rank 7.
+        PAWN_ATTACKS[WhitePlayer][sq] = 0;
+        PAWN_ATTACKS[BlackPlayer][sq] = 0;
+        for (int df = -1; df <= 1; df += 2) {
+            struct BoardPos white_check = boardpos_add(pos, BoardPos(df, -1));
+            if (!boardpos_eq(white_check, NULL_BOARDPOS)) PAWN_ATTACKS[WhitePlayer][sq] |= bb_from_pos(white_check);
+
+            struct BoardPos black_check = boardpos_add(pos, BoardPos(df, 1));
+            if (!boardpos_eq(black_check, NULL_BOARDPOS)) PAWN_ATTACKS[BlackPlayer][sq] |= bb_from_pos(black_check);
+        }
+
+        // Pawn front spans: the own and adjacent files, cut to the ranks strictly in front of
+        // the square. White pawns advance towards rank 0 and black pawns towards rank 7.
+        Bitboard files = bb_file(pos.file);
+        if (pos.file > 0) files |= bb_file(pos.file - 1);
+        if (pos.file < 7) files |= bb_file(pos.file + 1);
+        Bitboard in_front_white = pos.rank > 0 ? (1ULL << (pos.rank * 8)) - 1 : 0;
+        Bitboard in_front_black = pos.rank < 7 ? ~((1ULL << ((pos.rank + 1) * 8)) - 1) : 0;
+        PAWN_FRONT_SPAN[WhitePlayer][sq] = files & in_front_white;
+        PAWN_FRONT_SPAN[BlackPlayer][sq] = files & in_front_black;
+    }
+
+    // Between and line tables, derived from the rays. Walking each ray square by square lets the
+    // between mask accumulate for free.
+    for (int sq = 0; sq < 64; sq++) {
+        for (int dir = 0; dir < 8; dir++) {
+            Bitboard line = RAY_ATTACKS[dir][sq] | RAY_ATTACKS[(dir + 4) % 8][sq] | bb_from_square(sq);
+            Bitboard between = 0;
+            struct BoardPos check = boardpos_add(bb_to_pos(sq), RAY_DELTAS[dir]);
+            while (!boardpos_eq(check, NULL_BOARDPOS)) {
+                int check_sq = bb_square(check);
+                BETWEEN_BB[sq][check_sq] = between;
+                LINE_BB[sq][check_sq] = line;
+                between |= bb_from_square(check_sq);
+                check = boardpos_add(check, RAY_DELTAS[dir]);
+            }
+        }
+    }
+
+    tables_generated = true;
+}
+
+// Returns the squares strictly between two aligned squares, or 0 if they are not on a common rank,
+// file or diagonal.
+Bitboard bb_between(int a, int b) {
+    if (!tables_generated) bitboard_init();
+    return BETWEEN_BB[a][b];
+}
+
+// Returns the full line through two aligned squares out to the board edges (including both
+// squares), or 0 if they are not on a common rank, file or diagonal.
+Bitboard bb_line(int a, int b) {
+    if (!tables_generated) bitboard_init();
+    return LINE_BB[a][b];
+}
+
+// Returns the squares a knight on `sq` attacks
+Bitboard bb_knight_attacks(int sq) {
+    if (!tables_generated) bitboard_init();
+    return KNIGHT_ATTACKS[sq];
+}
+
+// Returns the squares a king on `sq` attacks
+Bitboard bb_king_attacks(int sq) {
+    if (!tables_generated) bitboard_init();
+    return KING_ATTACKS[sq];
+}
+
+// Returns the squares a pawn belonging to `player` on `sq` attacks
+Bitboard bb_pawn_attacks(int sq, enum Player player) {
+    if (!tables_generated) bitboard_init();
+    return PAWN_ATTACKS[player][sq];
+}
+
+// Returns the squares on the pawn's own and adjacent files strictly in front of `sq` (towards
+// `player`'s promotion rank). See PAWN_FRONT_SPAN.
+Bitboard bb_pawn_front_span(int sq, enum Player player) {
+    if (!tables_generated) bitboard_init();
+    return PAWN_FRONT_SPAN[player][sq];
+}
+
+// Returns the attacks along a single ray given the occupancy: the full ray up to and including
+// the first occupied square.
+static inline Bitboard ray_attacks(int dir, int sq, Bitboard occupancy) {
+    Bitboard attacks = RAY_ATTACKS[dir][sq];
+    Bitboard blockers = attacks & occupancy;
+    if (blockers) {
+        // Remove the squares behind the first blocker by XORing with the blocker's own ray.
+        int first = dir < 4 ? bb_scan_forward(blockers) : bb_scan_reverse(blockers);
+        attacks ^= RAY_ATTACKS[dir][first];
+    }
+    return attacks;
+}
+
+// Returns the squares a rook on `sq` attacks, given the occupancy of the whole board.
+// The first occupied square along each ray is included, whether it holds a friendly or an enemy
+// piece - callers mask out friendly pieces.
+Bitboard bb_rook_attacks(int sq, Bitboard occupancy) {
+    if (!tables_generated) bitboard_init();
+    return ray_attacks(0, sq, occupancy) | ray_attacks(2, sq, occupancy) | ray_attacks(4, sq, occupancy) |
+           ray_attacks(6, sq, occupancy);
+}
+
+// Returns the squares a bishop on `sq` attacks, given the occupancy of the whole board.
+Bitboard bb_bishop_attacks(int sq, Bitboard occupancy) {
+    if (!tables_generated) bitboard_init();
+    return ray_attacks(1, sq, occupancy) | ray_attacks(3, sq, occupancy) | ray_attacks(5, sq, occupancy) |
+           ray_attacks(7, sq, occupancy);
+}
+
+// Returns the squares a queen on `sq` attacks, given the occupancy of the whole board.
+Bitboard bb_queen_attacks(int sq, Bitboard occupancy) {
+    return bb_rook_attacks(sq, occupancy) | bb_bishop_attacks(sq, occupancy);
+}
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <bitboard.h>
 #include <chess.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,10 +32,44 @@ struct Piece Piece(enum PieceType type, enum Player player) {
     return p;
 }
 
-// Put a piece onto the board
+const int PIECE_VALUES[6] = {20000, 900, 500, 330, 320, 100};
+
+// The bonus a piece earns for standing on a square. Controlling the centre of the board is
+// advantageous in chess (due to better mobility etc.), so the central squares are worth a
+// little extra, with the innermost four worth the most.
+static int square_value(struct BoardPos pos) {
+    if (pos.file < 2 || pos.file > 5 || pos.rank < 2 || pos.rank > 5) return 0;
+    if (pos.file == 2 || pos.file == 5 || pos.rank == 2 || pos.rank == 5) return 2;
+    return 5;
+}
+
+// Put a piece onto the board, keeping the occupancy bitboards and the incremental evaluation
+// sums in sync with the board array
 // `pos` must be a valid position
 void put_piece(struct GameState *state, struct Piece piece, struct BoardPos pos) {
     assert(pos.file >= 0 && pos.file < 8 && pos.rank >= 0 && pos.rank < 8);
+
+    // Clear the square's bit for the previous occupant and set it for the new piece.
+    struct Piece prev = state->board[pos.file][pos.rank];
+    Bitboard mask = bb_from_pos(pos);
+    if (prev.type != Empty) {
+        state->bb_type[prev.type] &= ~mask;
+        state->bb_player[prev.player] &= ~mask;
+
+        int sign = prev.player == WhitePlayer ? 1 : -1;
+        state->material -= sign * PIECE_VALUES[prev.type - 1];
+        state->psq -= sign * square_value(pos);
+    }
+
+    if (piece.type != Empty) {
+        state->bb_type[piece.type] |= mask;
+        state->bb_player[piece.player] |= mask;
+
+        int sign = piece.player == WhitePlayer ? 1 : -1;
+        state->material += sign * PIECE_VALUES[piece.type - 1];
+        state->psq += sign * square_value(pos);
+    }
+
     state->board[pos.file][pos.rank] = piece;
 }
 
@@ -83,10 +118,16 @@ void unset_castlert_right(struct GameState *state, enum Player player) {
 // of the kings
 void clear_board(struct GameState *state) {
     memset(state->board, 0, sizeof(state->board));
+    memset(state->bb_type, 0, sizeof(state->bb_type));
+    memset(state->bb_player, 0, sizeof(state->bb_player));
     memset(state->piece_list_white, NULL_BOARDPOS.file, sizeof(state->piece_list_white));
     memset(state->piece_list_black, NULL_BOARDPOS.file, sizeof(state->piece_list_black));
     state->white_king = NULL_BOARDPOS;
     state->black_king = NULL_BOARDPOS;
+    state->material = 0;
+    state->psq = 0;
+    state->halfmove_clock = 0;
+    memset(state->hash_history, 0, sizeof(state->hash_history));
 }
 
 // Constructs a new gamestate representing the start of a default chess game
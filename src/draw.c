@@ -1,62 +1,99 @@
 #include <config.h>
 #include <draw.h>
 #include <raylib.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <zobrist.h>
 
-// Stores the textures used to draw chess pieces
-// Must be initialised before use by calling load_textures()
-static Texture2D white_piece_textures[6] = {0};
-static Texture2D black_piece_textures[6] = {0};
+// All twelve piece sprites baked into a single texture at load_textures() time. Column i holds
+// white piece type i+1, column 6+i the black equivalent, and a final solid white column feeds
+// raylib's shape drawing (see SetShapesTexture below). With every draw sourcing the same
+// texture, raylib batches the entire board into one draw call instead of one per square.
+static Texture2D piece_atlas = {0};
 
-// Load the piece textures from disk (stored in $PWD/res/) into VRAM
-// Texture info stored in a static array, resizing the images if needed
+// The rendered board is cached in a texture and only re-rendered when the position changes, so
+// an idle frame costs a single blit and the CPU stays dedicated to the search threads.
+static RenderTexture2D board_cache = {0};
+static ZobristHash board_cache_hash = 0;
+static bool board_cache_valid = false;
+
+// Load the piece sprites from disk (stored in $PWD/res/) and bake them into the atlas texture,
+// resizing the images to the board square size. Also allocates the board cache.
 // Textures must be unloaded from VRAM with unload_textures()
 void load_textures() {
+    Image atlas_image = GenImageColor(BOARD_SQUARE_SIZE * 13, BOARD_SQUARE_SIZE, BLANK);
+    ImageDrawRectangle(&atlas_image, BOARD_SQUARE_SIZE * 12, 0, BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE, WHITE);
+
     for (int i = 0; i < 6; i += 1) {
-        char filename[18];
-        sprintf(filename, "res/piece_%d_w.png", i);
-        Image piece_image = LoadImage(filename);
-        ImageResize(&piece_image, BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE);
-        white_piece_textures[i] = LoadTextureFromImage(piece_image);
-        UnloadImage(piece_image);
-
-        sprintf(filename, "res/piece_%d_b.png", i);
-        piece_image = LoadImage(filename);
-        ImageResize(&piece_image, BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE);
-        black_piece_textures[i] = LoadTextureFromImage(piece_image);
-        UnloadImage(piece_image);
+        for (int player = 0; player < 2; player++) {
+            char filename[18];
+            sprintf(filename, "res/piece_%d_%c.png", i, player == WhitePlayer ? 'w' : 'b');
+            Image piece_image = LoadImage(filename);
+            ImageResize(&piece_image, BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE);
+            ImageDraw(&atlas_image, piece_image, (Rectangle){0, 0, BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE},
+                      (Rectangle){BOARD_SQUARE_SIZE * (6 * player + i), 0, BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE},
+                      WHITE);
+            UnloadImage(piece_image);
+        }
     }
+
+    piece_atlas = LoadTextureFromImage(atlas_image);
+    UnloadImage(atlas_image);
+
+    // Route raylib's shape drawing (the square backgrounds, selection circle, move line and UI
+    // rectangles) through the atlas' white column, so shapes and pieces share a texture and
+    // batch together instead of forcing a texture switch between them.
+    SetShapesTexture(piece_atlas, (Rectangle){BOARD_SQUARE_SIZE * 12 + 1, 1, 1, 1});
+
+    board_cache = LoadRenderTexture(BOARD_SIZE, BOARD_SIZE);
+    board_cache_valid = false;
 }
 
 // Unload textures which were loaded with `load_textures` from VRAM
 void unload_textures() {
-    for (int i = 0; i < 6; i++) {
-        UnloadTexture(white_piece_textures[i]);
-        UnloadTexture(black_piece_textures[i]);
-    }
+    UnloadRenderTexture(board_cache);
+    UnloadTexture(piece_atlas);
 }
 
-// Draws a chess piece at a specified square position
+// Force the next draw_board call to re-render the cached board texture. Only needed when the
+// board is changed without its Zobrist hash being updated (the debug copy-on-move key).
+void invalidate_board_cache() { board_cache_valid = false; }
+
+// Draws a chess piece at a specified square position from the atlas
 // Piece textures must be loaded prior to call via load_textures()
-// Should be called within BeginDrawing/EndDrawing
 static void draw_piece(struct Piece piece, struct BoardPos pos) {
     if (piece.type == Empty) return;
-    Texture2D texture = (piece.player == WhitePlayer ? white_piece_textures : black_piece_textures)[piece.type - 1];
-    DrawTexture(texture, BOARD_SQUARE_SIZE * pos.file, BOARD_SQUARE_SIZE * pos.rank, WHITE);
+    int column = 6 * piece.player + piece.type - 1;
+    DrawTextureRec(piece_atlas, (Rectangle){BOARD_SQUARE_SIZE * column, 0, BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE},
+                   (Vector2){BOARD_SQUARE_SIZE * pos.file, BOARD_SQUARE_SIZE * pos.rank}, WHITE);
 }
 
 // Draws a chess board from a GameState, including the pieces and the board background
 // Should be called within BeginDrawing/EndDrawing
 void draw_board(struct GameState *state) {
-    for (int file = 0; file < 8; file++) {
-        for (int rank = 0; rank < 8; rank++) {
-            // Draw the square background
-            Color square_colour = GetColor((file + rank) % 2 == 0 ? LIGHT_SQUARE_COLOUR : DARK_SQUARE_COLOUR);
-            DrawRectangle(file * BOARD_SQUARE_SIZE, rank * BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE,
-                          square_colour);
-
-            // Draw the piece
-            draw_piece(get_piece(state, BoardPos(file, rank)), BoardPos(file, rank));
+    // Re-render the cache only when the position changed since the last frame, identified by the
+    // incrementally maintained Zobrist hash. Everything that changes more often (the selection
+    // circle, the search line, the UI) is layered on top by the callers every frame, so none of
+    // it needs to key the cache.
+    if (!board_cache_valid || board_cache_hash != state->hash) {
+        BeginTextureMode(board_cache);
+        for (int file = 0; file < 8; file++) {
+            for (int rank = 0; rank < 8; rank++) {
+                // Draw the square background
+                Color square_colour = GetColor((file + rank) % 2 == 0 ? LIGHT_SQUARE_COLOUR : DARK_SQUARE_COLOUR);
+                DrawRectangle(file * BOARD_SQUARE_SIZE, rank * BOARD_SQUARE_SIZE, BOARD_SQUARE_SIZE,
+                              BOARD_SQUARE_SIZE, square_colour);
+
+                // Draw the piece
+                draw_piece(get_piece(state, BoardPos(file, rank)), BoardPos(file, rank));
+            }
         }
+        EndTextureMode();
+
+        board_cache_hash = state->hash;
+        board_cache_valid = true;
     }
+
+    // Render textures are stored upside down, hence the negative source height.
+    DrawTextureRec(board_cache.texture, (Rectangle){0, 0, BOARD_SIZE, -BOARD_SIZE}, (Vector2){0, 0}, WHITE);
 }
@@ -1,6 +1,9 @@
+#include <arena.h>
 #include <assert.h>
+#include <bitboard.h>
 #include <config.h>
 #include <engine.h>
+#include <kpk.h>
 #include <limits.h>
 #include <math.h>
 #include <openings.h>
@@ -8,25 +11,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <threadpool.h>
-#include <time.h>
+#include <timeman.h>
 #include <tptable.h>
 #include <util.h>
 #include <zobrist.h>
 
-// clang-format off
-// A list of all move directions white piece can make in (x,y), indexed by the (piece id - 1)
-// where {0xf, 0xf} is the null boardpos (no direction)
-// The magnitude is also stored e.g. for knight 2 is used to represent the long part of the  'L-shape'
-static const struct BoardPos PIECE_MOVE_DIRECTIONS[6][8] = {
-    {{0, 1}, {1, 1}, {1, 0}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}, {1, -1}}, // Queen
-    {{0, 1}, {1, 1}, {1, 0}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}, {1, -1}}, // King
-    {{0, 1}, {0, -1}, {-1, 0}, {1, 0}, {0xf, 0xf}, {0xf, 0xf}, {0xf, 0xf}, {0xf, 0xf}}, // Rook
-    {{1, 1}, {-1, -1}, {1, -1}, {-1, 1}, {0xf, 0xf}, {0xf, 0xf}, {0xf, 0xf}, {0xf, 0xf}}, // Bishop
-    {{2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {-1, 2}, {1, -2}, {-1, -2}}, // Knight
-    {{1, -1}, {-1, -1}, {0, -1}, {0, -2}, {0xf, 0xf}, {0xf, 0xf}, {0xf, 0xf}, {0xf, 0xf}} // Pawn
-};
-// clang-format on
-
 // The starting positions for the white and black rooks
 const struct BoardPos ROOK_STARTING_POSITIONS_LEFT[2] = {{0, 7}, {0, 0}};
 const struct BoardPos ROOK_STARTING_POSITIONS_RIGHT[2] = {{7, 7}, {7, 0}};
@@ -34,35 +23,384 @@ const struct BoardPos ROOK_STARTING_POSITIONS_RIGHT[2] = {{7, 7}, {7, 0}};
 // The starting positions for the white and black kings
 const struct BoardPos KING_STARTING_POSITIONS[2] = {{4, 7}, {4, 0}};
 
+// The theoretical maximum number of legal moves in any chess position.
+#define MOVE_LIST_MAX 218
+
+// An upper bound on the length of a quiescence search capture chain: every capture removes one of
+// the at most 30 capturable pieces from the board.
+#define QUIESCENCE_MAX_PLY 32
+
+// An upper bound on the search's arena usage: at every ply of the search the move list builder
+// holds a captures list, a quiet-moves list and the combined ordered list (3 * MOVE_LIST_MAX
+// moves), each quiescence ply holds one capture list, plus the private root state copy. Extra
+// slack covers per-allocation alignment padding.
+#define SEARCH_ARENA_SIZE                                                                                      \
+    (((MAX_SEARCH_DEPTH + 1) * 3 + QUIESCENCE_MAX_PLY) * MOVE_LIST_MAX * sizeof(struct Move) +                 \
+     sizeof(struct GameState) + 4096)
+
+#ifdef HAS_C11_CONCURRENCY
+#define SEARCH_THREAD_LOCAL _Thread_local
+#else
+// Without C11 threads the search runs single threaded, so one shared arena is safe.
+#define SEARCH_THREAD_LOCAL
+#endif
+
+// Each search thread gets its own arena so move lists and state copies never touch malloc (or its
+// lock) on the hot path. The iterative deepening tasks run on thread pool threads, so the arena
+// and its backing buffer are thread local and initialised lazily on each thread's first search.
+static SEARCH_THREAD_LOCAL unsigned char search_arena_buf[SEARCH_ARENA_SIZE];
+static SEARCH_THREAD_LOCAL struct Arena search_arena;
+static SEARCH_THREAD_LOCAL bool search_arena_ready = false;
+
+// Returns this thread's search arena, initialising it on first use.
+static struct Arena *get_search_arena() {
+    if (!search_arena_ready) {
+        arena_init(&search_arena, search_arena_buf, sizeof(search_arena_buf));
+        search_arena_ready = true;
+    }
+    return &search_arena;
+}
+
+// Returns whether the running search should be aborted. The stop flag and the clock are only
+// consulted once every SEARCH_TIME_CHECK_NODES calls (counted per thread), so the per-node cost
+// is a counter decrement instead of a clock read. A worker which sees the hard deadline pass sets
+// the stop flag, so every other worker aborts at its own next check.
+static bool search_should_stop(struct TimeManager *tm) {
+    static SEARCH_THREAD_LOCAL unsigned int nodes_until_check = SEARCH_TIME_CHECK_NODES;
+    if (--nodes_until_check > 0) return false;
+    nodes_until_check = SEARCH_TIME_CHECK_NODES;
+
+    if (timeman_stopped(tm)) return true;
+    if (timeman_hard_expired(tm)) {
+        timeman_stop(tm);
+        return true;
+    }
+    return false;
+}
+
+// Search statistics. The hot path only ever increments this thread's private struct; when a
+// worker's deepening loop ends it folds its counts into the shared totals under a mutex, taken
+// once per worker per search. generate_move_timed resets the totals before starting the workers.
+static SEARCH_THREAD_LOCAL struct SearchStats thread_stats;
+static struct SearchStats total_stats;
+#ifdef HAS_C11_CONCURRENCY
+static once_flag total_stats_mtx_once = ONCE_FLAG_INIT;
+static mtx_t total_stats_mtx;
+static void total_stats_mtx_init(void) { mtx_init(&total_stats_mtx, mtx_plain); }
+#endif
+
+static void total_stats_lock() {
+#ifdef HAS_C11_CONCURRENCY
+    call_once(&total_stats_mtx_once, total_stats_mtx_init);
+    mtx_lock(&total_stats_mtx);
+#endif
+}
+
+static void total_stats_unlock() {
+#ifdef HAS_C11_CONCURRENCY
+    mtx_unlock(&total_stats_mtx);
+#endif
+}
+
+// Folds this thread's counters into the shared totals and clears them for the next search.
+static void search_stats_flush() {
+    total_stats_lock();
+    total_stats.nodes += thread_stats.nodes;
+    total_stats.qnodes += thread_stats.qnodes;
+    total_stats.tt_probes += thread_stats.tt_probes;
+    total_stats.tt_hits += thread_stats.tt_hits;
+    total_stats.tt_cutoffs += thread_stats.tt_cutoffs;
+    total_stats.beta_cutoffs += thread_stats.beta_cutoffs;
+    total_stats.beta_cutoffs_first += thread_stats.beta_cutoffs_first;
+    total_stats.depth = MAX(total_stats.depth, thread_stats.depth);
+    total_stats.elapsed_ms = MAX(total_stats.elapsed_ms, thread_stats.elapsed_ms);
+    total_stats_unlock();
+    memset(&thread_stats, 0, sizeof(thread_stats));
+}
+
+// Returns the statistics totals of the last completed search (or the running totals of an
+// unfinished one, if workers have already flushed).
+struct SearchStats search_stats_get() {
+    total_stats_lock();
+    struct SearchStats out = total_stats;
+    total_stats_unlock();
+    return out;
+}
+
+// The search completion mailbox. The main worker publishes the best root move, value and depth
+// after every completed iteration, so the frontend learns the result (and notices completion
+// immediately) with two atomic loads per frame instead of probing the transposition table.
+// Like the transposition table entries, the two words are XOR-validated against the root
+// position hash: a stale publish from an aborted ponder search can never be mistaken for a
+// result for the position actually on the board, so no clearing or synchronisation with the
+// frontend is needed.
+#ifdef HAS_C11_CONCURRENCY
+static atomic_uint_fast64_t search_result_key;
+static atomic_uint_fast64_t search_result_data;
+#else
+static uint64_t search_result_key;
+static uint64_t search_result_data;
+#endif
+
+// Packs a search result into one word: bit 0 always set (so an empty mailbox can never
+// validate), the move squares in bits 1-12, the depth in bits 13-20 and the value in bits 21-52.
+static uint64_t search_result_pack(struct Move move, int value, int depth) {
+    uint64_t word = 1;
+    word |= (uint64_t)(move.from.file & 7) << 1;
+    word |= (uint64_t)(move.from.rank & 7) << 4;
+    word |= (uint64_t)(move.to.file & 7) << 7;
+    word |= (uint64_t)(move.to.rank & 7) << 10;
+    word |= (uint64_t)(uint8_t)depth << 13;
+    word |= (uint64_t)(uint32_t)value << 21;
+    return word;
+}
+
+// Publishes a completed iteration's result to the mailbox.
+static void search_result_publish(ZobristHash root_hash, struct Move move, int value, int depth) {
+    uint64_t data = search_result_pack(move, value, depth);
+#ifdef HAS_C11_CONCURRENCY
+    atomic_store_explicit(&search_result_data, data, memory_order_relaxed);
+    atomic_store_explicit(&search_result_key, root_hash ^ data, memory_order_relaxed);
+#else
+    search_result_data = data;
+    search_result_key = root_hash ^ data;
+#endif
+}
+
+// Reads the mailbox. Returns true and fills `out` if it holds a result for the position with
+// hash `root_hash`, and false otherwise (nothing published yet, or the result is for another
+// position, e.g. one a ponder search speculated on).
+bool search_result_get(ZobristHash root_hash, struct SearchResult *out) {
+#ifdef HAS_C11_CONCURRENCY
+    uint64_t key = atomic_load_explicit(&search_result_key, memory_order_relaxed);
+    uint64_t data = atomic_load_explicit(&search_result_data, memory_order_relaxed);
+#else
+    uint64_t key = search_result_key;
+    uint64_t data = search_result_data;
+#endif
+
+    if ((data & 1) == 0 || (key ^ data) != root_hash) return false;
+
+    out->best_move.from = BoardPos((data >> 1) & 7, (data >> 4) & 7);
+    out->best_move.to = BoardPos((data >> 7) & 7, (data >> 10) & 7);
+    out->depth = (int)((data >> 13) & 0xff);
+    out->value = (int)(int32_t)(uint32_t)(data >> 21);
+    return true;
+}
+
+// Move ordering heuristics. Alpha-beta pruning cuts the tree the earlier the better moves are
+// searched, so quiet moves that caused a beta cutoff are remembered and tried early when they
+// reappear: the killer slots hold the last two cutoff moves per ply (cutoffs tend to repeat in
+// sibling nodes), and the butterfly history table counts cutoffs per player/from/to square over
+// the whole tree, weighted towards deeper (more expensive) subtrees. Both tables are per search
+// thread so the Lazy SMP workers never contend on shared cache lines.
+#define KILLER_SLOTS 2
+static SEARCH_THREAD_LOCAL struct Move killer_moves[MAX_SEARCH_DEPTH + 1][KILLER_SLOTS];
+static SEARCH_THREAD_LOCAL int history_table[2][64][64];
+
+// Move ordering scores. Captures are searched before killers, and killers before other quiet
+// moves, so the score bands must not overlap: the worst capture score is
+// CAPTURE_SCORE_BASE - PIECE_VALUES[King - 1] and history values are capped at HISTORY_MAX.
+#define CAPTURE_SCORE_BASE (1 << 22)
+#define KILLER_SCORE (1 << 21)
+#define HISTORY_MAX (1 << 20)
+
+static bool moves_eq(struct Move a, struct Move b) {
+    return boardpos_eq(a.from, b.from) && boardpos_eq(a.to, b.to);
+}
+
+// Returns every piece of either player attacking `sq`, given `occupancy` (which may differ from
+// the board's occupancy while an exchange is being resolved, to let sliders attack through the
+// pieces that have already been traded off).
+static Bitboard attackers_to(struct GameState *state, int sq, Bitboard occupancy) {
+    Bitboard rook_like = state->bb_type[Rook] | state->bb_type[Queen];
+    Bitboard bishop_like = state->bb_type[Bishop] | state->bb_type[Queen];
+
+    // A pawn attacks sq from the squares a pawn of the other colour on sq would attack.
+    return (bb_rook_attacks(sq, occupancy) & rook_like) | (bb_bishop_attacks(sq, occupancy) & bishop_like) |
+           (bb_knight_attacks(sq) & state->bb_type[Knight]) | (bb_king_attacks(sq) & state->bb_type[King]) |
+           (bb_pawn_attacks(sq, WhitePlayer) & state->bb_type[Pawn] & state->bb_player[BlackPlayer]) |
+           (bb_pawn_attacks(sq, BlackPlayer) & state->bb_type[Pawn] & state->bb_player[WhitePlayer]);
+}
+
+// Static exchange evaluation: resolves the sequence of captures on the destination square of
+// `move`, assuming both sides always recapture with their least valuable attacker and may stop
+// recapturing whenever continuing would lose material. Returns the material balance the moving
+// player can guarantee from the exchange; negative means the capture loses material even with
+// best play, e.g. taking a defended pawn with the queen.
+// https://www.chessprogramming.org/Static_Exchange_Evaluation
+static int see(struct GameState *state, struct Move move) {
+    int sq = bb_square(move.to);
+    struct Piece attacker = get_piece(state, move.from);
+    struct Piece victim = get_piece(state, move.to);
+
+    Bitboard occupancy = state->bb_player[WhitePlayer] | state->bb_player[BlackPlayer];
+
+    // For en passant the captured pawn is not on the destination square.
+    if (victim.type == Empty) {
+        occupancy &= ~bb_from_pos(BoardPos(move.to.file, move.from.rank));
+    }
+    enum PieceType victim_type = victim.type != Empty ? victim.type : Pawn;
+
+    Bitboard rook_like = state->bb_type[Rook] | state->bb_type[Queen];
+    Bitboard bishop_like = state->bb_type[Bishop] | state->bb_type[Queen];
+
+    // gain[d] holds the material balance after d+1 captures, from the perspective of the side
+    // that made the (d+1)th capture. At most 32 pieces can take part in the exchange.
+    int gain[33];
+    int d = 0;
+    gain[0] = PIECE_VALUES[victim_type - 1];
+
+    enum PieceType moving = attacker.type;
+    enum Player side = attacker.player;
+    Bitboard from_bb = bb_from_pos(move.from);
+    Bitboard attackers = attackers_to(state, sq, occupancy);
+
+    while (true) {
+        // Make the capture: the capturing piece leaves its square, which can open an x-ray attack
+        // from a slider that was standing behind it.
+        occupancy ^= from_bb;
+        attackers = (attackers | (bb_rook_attacks(sq, occupancy) & rook_like) |
+                     (bb_bishop_attacks(sq, occupancy) & bishop_like)) &
+                    occupancy;
+
+        side = other_player(side);
+        Bitboard side_attackers = attackers & state->bb_player[side];
+        if (!side_attackers) break;
+
+        // Recapture with the least valuable attacker.
+        static const enum PieceType LVA_ORDER[6] = {Pawn, Knight, Bishop, Rook, Queen, King};
+        enum PieceType lva = Empty;
+        for (int i = 0; i < 6; i++) {
+            Bitboard candidates = side_attackers & state->bb_type[LVA_ORDER[i]];
+            if (candidates) {
+                lva = LVA_ORDER[i];
+                from_bb = candidates & -candidates;
+                break;
+            }
+        }
+
+        // The king cannot legally recapture onto a square the opponent still attacks.
+        if (lva == King && (attackers & state->bb_player[other_player(side)])) break;
+
+        // The piece that made the previous capture becomes the new victim.
+        d++;
+        gain[d] = PIECE_VALUES[moving - 1] - gain[d - 1];
+        moving = lva;
+    }
+
+    // Resolve the exchange from the end backwards: at each step the side to move keeps the better
+    // of stopping (the negated balance so far) or continuing with the capture.
+    while (d > 0) {
+        gain[d - 1] = -MAX(-gain[d - 1], gain[d]);
+        d--;
+    }
+    return gain[0];
+}
+
+// Scores a capture (or promotion push) for ordering. Winning and equal exchanges are ranked by
+// most-valuable-victim/least-valuable-attacker: winning the biggest piece with the smallest
+// attacker is most likely to stand up to recapture. Captures that lose material by static
+// exchange evaluation score below every quiet move instead.
+static int capture_score(struct GameState *state, struct Move move) {
+    struct Piece attacker = get_piece(state, move.from);
+    struct Piece victim = get_piece(state, move.to);
+
+    // A promotion push is a noisy non-capture: rank it like winning a queen with a pawn.
+    if (attacker.type == Pawn && move.from.file == move.to.file) {
+        return CAPTURE_SCORE_BASE + 10 * PIECE_VALUES[Queen - 1] - PIECE_VALUES[Pawn - 1];
+    }
+
+    // En passant captures land on an empty square; the victim is always a pawn.
+    enum PieceType victim_type = victim.type != Empty ? victim.type : Pawn;
+
+    // A capture can only lose material when the attacker is worth more than the victim, so the
+    // exchange evaluation is skipped for the common pawn-takes-piece cases.
+    if (PIECE_VALUES[attacker.type - 1] > PIECE_VALUES[victim_type - 1]) {
+        int exchange = see(state, move);
+        if (exchange < 0) return exchange;
+    }
+
+    return CAPTURE_SCORE_BASE + 10 * PIECE_VALUES[victim_type - 1] - PIECE_VALUES[attacker.type - 1];
+}
+
+// Records a quiet move that caused a beta cutoff in the killer slots for its ply and the history
+// table, so it is tried earlier when it comes up again.
+static void record_quiet_cutoff(enum Player player, struct Move move, int depth, int ply) {
+    if (!moves_eq(killer_moves[ply][0], move)) {
+        killer_moves[ply][1] = killer_moves[ply][0];
+        killer_moves[ply][0] = move;
+    }
+
+    // Deeper subtrees are more expensive to search, so cutoffs there earn a bigger bonus.
+    int *entry = &history_table[player][bb_square(move.from)][bb_square(move.to)];
+    *entry += depth * depth;
+
+    // Keep the scores below the killer band, halving every entry so the relative order survives.
+    if (*entry >= HISTORY_MAX) {
+        for (int i = 0; i < 64 * 64; i++) {
+            history_table[player][i / 64][i % 64] /= 2;
+        }
+    }
+}
+
+// Sorts `moves[0..count)` by `scores` in descending order (insertion sort: the lists are short
+// and usually nearly sorted after the first few iterative deepening passes).
+static void sort_moves_by_score(struct Move *moves, int *scores, int count) {
+    for (int i = 1; i < count; i++) {
+        struct Move move = moves[i];
+        int score = scores[i];
+        int j = i - 1;
+        while (j >= 0 && scores[j] < score) {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+            j--;
+        }
+        moves[j + 1] = move;
+        scores[j + 1] = score;
+    }
+}
+
+// The legality masks for the side to move, computed once per node from the king position. Filtering
+// candidate moves against these is much cheaper than make/unmake-testing every one; only en passant
+// and castling still fall back to the make/unmake test (see is_move_legal_masked).
+struct LegalityMasks {
+    Bitboard check_mask;  // Squares a non-king move must land on: every square when not in check,
+                          // the checker and its blocking squares with one checker, none with two
+    Bitboard pinned;      // The player's absolutely pinned pieces
+};
+
+static struct LegalityMasks compute_legality_masks(struct GameState *state, enum Player player);
+static bool is_move_legal_masked(struct GameState *state, struct Move move, const struct LegalityMasks *masks);
+
 // Writes an array of the legal move destinations the piece at `initial` can make to `moves_dest`.
 // `moves_dest` must be an array of length at least `PIECE_LEGAL_MOVES_MAX` (defined in engine.h).
+// `masks` must hold the legality masks for the piece's player in the current position.
 // Returns the number of legal moves.
 static unsigned int legal_moves_from_pos(struct GameState *state, struct BoardPos initial,
-                                         struct BoardPos *moves_dest) {
+                                         struct BoardPos *moves_dest, const struct LegalityMasks *masks) {
     struct Piece piece = get_piece(state, initial);
     unsigned int moves_idx = 0;
 
-    // Each piece has different patterns which they are allowed to move in.
-    // Every move possibility will be checked for the piece type to get all the legal moves.
+    int sq = bb_square(initial);
+    Bitboard occupancy = state->bb_player[WhitePlayer] | state->bb_player[BlackPlayer];
+    Bitboard own = state->bb_player[piece.player];
+
+    // A bitboard of candidate destination squares is built from the precomputed attack maps, then
+    // each candidate is filtered through is_move_legal_masked (which handles checks, pins,
+    // castling rights and the pawn special cases).
+    Bitboard targets = 0;
+
     switch (piece.type) {
         case King:
-            for (int i = 0; i < 8; i++) {
-                // Check each possible move direction to see if it is legal.
-                struct BoardPos direction = PIECE_MOVE_DIRECTIONS[piece.type - 1][i];
-                struct BoardPos check = boardpos_add(initial, direction);
-                if (!boardpos_eq(check, NULL_BOARDPOS)) {
-                    if (is_move_legal(state, (struct Move){initial, check})) {
-                        moves_dest[moves_idx++] = check;
-                    }
-                }
-            }
+            targets = bb_king_attacks(sq) & ~own;
 
             // Check each possible castling move if the king is at its starting position.
             if (boardpos_eq(initial, KING_STARTING_POSITIONS[piece.player == WhitePlayer ? 0 : 1])) {
                 static const struct BoardPos castling_directions[2] = {{2, 0}, {-2, 0}};
                 for (int i = 0; i < 2; i++) {
                     struct BoardPos check = boardpos_add(initial, castling_directions[i]);
-                    if (is_move_legal(state, (struct Move){initial, check})) {
+                    if (is_move_legal_masked(state, (struct Move){initial, check}, masks)) {
                         moves_dest[moves_idx++] = check;
                     }
                 }
@@ -71,146 +409,276 @@ static unsigned int legal_moves_from_pos(struct GameState *state, struct BoardPo
             break;
 
         case Queen:
-        case Rook:
-        case Bishop:
-            for (int i = 0; i < 8 && !boardpos_eq(PIECE_MOVE_DIRECTIONS[piece.type - 1][i], NULL_BOARDPOS); i++) {
-                // Check each possible move direction for legality.
-                struct BoardPos check = boardpos_add(initial, PIECE_MOVE_DIRECTIONS[piece.type - 1][i]);
+            targets = bb_queen_attacks(sq, occupancy) & ~own;
+            break;
 
-                // The queen, rook and bishop can move multiple times in the same direction.
-                while (!boardpos_eq(check, NULL_BOARDPOS)) {
-                    if (is_move_legal(state, (struct Move){initial, check})) {
-                        moves_dest[moves_idx++] = check;
-                    }
+        case Rook:
+            targets = bb_rook_attacks(sq, occupancy) & ~own;
+            break;
 
-                    check = boardpos_add(check, PIECE_MOVE_DIRECTIONS[piece.type - 1][i]);
-                }
-            }
+        case Bishop:
+            targets = bb_bishop_attacks(sq, occupancy) & ~own;
             break;
 
         case Knight:
-            for (int i = 0; i < 8 && !boardpos_eq(PIECE_MOVE_DIRECTIONS[piece.type - 1][i], NULL_BOARDPOS); i++) {
-                // Check each possible move direction for legality.
-                struct BoardPos direction = PIECE_MOVE_DIRECTIONS[piece.type - 1][i];
-                struct BoardPos check = boardpos_add(initial, direction);
-                if (!boardpos_eq(check, NULL_BOARDPOS)) {
-                    if (is_move_legal(state, (struct Move){initial, check})) {
-                        moves_dest[moves_idx++] = check;
-                    }
-                }
-            }
+            targets = bb_knight_attacks(sq) & ~own;
             break;
 
-        case Pawn:
-            for (int i = 0; i < 8 && !boardpos_eq(PIECE_MOVE_DIRECTIONS[piece.type - 1][i], NULL_BOARDPOS); i++) {
-                // Check each possible move direction for legality.
-                struct BoardPos direction = PIECE_MOVE_DIRECTIONS[piece.type - 1][i];
-
-                // If it is black moving the pawns move in the opposite direction.
-                if (piece.player == BlackPlayer) {
-                    direction.file *= -1;
-                    direction.rank *= -1;
-                }
-
-                struct BoardPos check = boardpos_add(initial, direction);
-                if (!boardpos_eq(check, NULL_BOARDPOS)) {
-                    if (is_move_legal(state, (struct Move){initial, check})) {
-                        moves_dest[moves_idx++] = check;
-                    }
-                }
-            }
+        case Pawn: {
+            // Diagonal captures, including en passant captures onto an empty square which
+            // is_move_legal_masked validates against the en passant target files.
+            targets = bb_pawn_attacks(sq, piece.player) & ~own;
+
+            // Single and double pushes. Occupancy of the push squares is checked by
+            // is_move_legal_masked, matching the other candidate moves.
+            int direction = piece.player == BlackPlayer ? 1 : -1;
+            struct BoardPos push = boardpos_add(initial, BoardPos(0, direction));
+            if (!boardpos_eq(push, NULL_BOARDPOS)) targets |= bb_from_pos(push);
+            struct BoardPos double_push = boardpos_add(initial, BoardPos(0, 2 * direction));
+            if (!boardpos_eq(double_push, NULL_BOARDPOS)) targets |= bb_from_pos(double_push);
             break;
+        }
 
         default:
             return 0;
     }
 
+    // Check each candidate destination for legality.
+    while (targets) {
+        struct BoardPos check = bb_to_pos(bb_scan_forward(targets));
+        targets &= targets - 1;
+        if (is_move_legal_masked(state, (struct Move){initial, check}, masks)) {
+            moves_dest[moves_idx++] = check;
+        }
+    }
+
     return moves_idx;
 }
 
 // Writes a list of all the legal moves for a player, ordered using a heuristic to place the better moves first.
-// The list must be deallocated.
+// The list is allocated from `arena`; the caller frees it (together with the intermediate lists)
+// by releasing the arena back to its mark when the node exits.
 // Returns the number of moves in the list.
-static unsigned int all_legal_moves_ordered(struct GameState *state, enum Player player, struct Move **moves_out) {
-    // Captures and other moves will be collected separately, as captures are likely to be better moves.
-    int moves_size = 50;
+static unsigned int all_legal_moves_ordered(struct GameState *state, enum Player player, struct Move **moves_out,
+                                            struct Arena *arena, int ply) {
+    // MOVE_LIST_MAX bounds the number of legal moves in any position, so unlike the old
+    // malloc/realloc lists no resizing is ever needed.
     int moves_idx = 0;
-    int captures_size = 9;
-    int captures_idx = 0;
-    struct Move *moves = malloc(sizeof(struct Move) * 50);
-    struct Move *captures = malloc(sizeof(struct Move) * 9);
+    struct Move *moves = arena_alloc(arena, sizeof(struct Move) * MOVE_LIST_MAX);
+    int scores[MOVE_LIST_MAX];
 
-    // If there is a principal variation stored in the transposition table for this position, place that move first as
-    // it is known to be the best.
+    // If there is a principal variation stored in the transposition table for this position it is
+    // known to be the best move, so it outranks every heuristic score.
     struct TranspositionEntry tp_entry = tptable_get(state->hash);
     bool has_pvn = tp_entry.depth != 0 && !boardpos_eq(tp_entry.best_move.from, NULL_BOARDPOS);
-    bool waiting_for_pvn = has_pvn;
 
-    // Get all legal moves for each piece.
+    // The check and pin masks are computed once here and shared by every piece's legality checks.
+    struct LegalityMasks masks = compute_legality_masks(state, player);
+
+    // Get all legal moves for each piece, scoring each move as it is added: the principal
+    // variation first, then captures by most-valuable-victim/least-valuable-attacker, then the
+    // current ply's killer moves, then the remaining quiet moves by their history counts.
     struct BoardPos *piece_list = player == WhitePlayer ? state->piece_list_white : state->piece_list_black;
     for (int i = 0; i < 16; i++) {
         struct BoardPos from = piece_list[i];
         if (boardpos_eq(from, NULL_BOARDPOS)) continue;
         struct Piece from_piece = get_piece(state, from);
 
-        // If there is insufficent space in the arrays extend them.
-        if (moves_size - moves_idx < 27) {
-            moves = realloc(moves, sizeof(struct Move) * moves_size * 2);
-            moves_size *= 2;
-        }
-
-        if (captures_size - captures_idx < 9) {
-            captures = realloc(captures, sizeof(struct Move) * captures_size * 2);
-            captures_size *= 2;
-        }
-
         // Get all the legal moves for this piece.
         struct BoardPos legal_moves[PIECE_LEGAL_MOVES_MAX];
-        int move_count = legal_moves_from_pos(state, from, legal_moves);
+        int move_count = legal_moves_from_pos(state, from, legal_moves, &masks);
 
-        // Add each move to either the captures array or the other moves list.
         for (int m = 0; m < move_count; m++) {
-            // If this move is the principal variation then skip, as the principal variation will be added to the start.
-            if (waiting_for_pvn && boardpos_eq(tp_entry.best_move.from, from) &&
-                boardpos_eq(tp_entry.best_move.to, legal_moves[m])) {
-                waiting_for_pvn = false;
-                continue;
-            }
+            struct Move move = {from, legal_moves[m]};
 
             // Check if the move is a capture.
             struct Piece to_piece = get_piece(state, legal_moves[m]);
-            if ((to_piece.type != Empty && to_piece.player != player) ||
-                (from_piece.type == Pawn && from.file != legal_moves[m].file)) {
-                captures[captures_idx++] = (struct Move){from, legal_moves[m]};
+            bool capture = (to_piece.type != Empty && to_piece.player != player) ||
+                           (from_piece.type == Pawn && from.file != legal_moves[m].file);
+
+            int score;
+            if (has_pvn && moves_eq(move, tp_entry.best_move)) {
+                score = INT_MAX;
+            } else if (capture) {
+                score = capture_score(state, move);
+            } else if (moves_eq(move, killer_moves[ply][0])) {
+                score = KILLER_SCORE + 1;
+            } else if (moves_eq(move, killer_moves[ply][1])) {
+                score = KILLER_SCORE;
             } else {
-                moves[moves_idx++] = (struct Move){from, legal_moves[m]};
+                score = history_table[player][bb_square(from)][bb_square(legal_moves[m])];
             }
+
+            scores[moves_idx] = score;
+            moves[moves_idx++] = move;
         }
     }
 
-    size_t move_count = moves_idx + captures_idx + has_pvn;
+    sort_moves_by_score(moves, scores, moves_idx);
+
+    *moves_out = moves;
+    return moves_idx;
+}
+
+// Writes a list of the legal captures and promotions for a player, the "noisy" moves searched by
+// the quiescence stage, ordered by most-valuable-victim/least-valuable-attacker. The list is
+// allocated from `arena`, released by the caller via its mark.
+// Returns the number of moves in the list.
+static unsigned int all_legal_captures(struct GameState *state, enum Player player, struct Move **moves_out,
+                                       struct Arena *arena) {
+    struct Move *captures = arena_alloc(arena, sizeof(struct Move) * MOVE_LIST_MAX);
+    int scores[MOVE_LIST_MAX];
+    int captures_idx = 0;
+
+    Bitboard occupancy = state->bb_player[WhitePlayer] | state->bb_player[BlackPlayer];
+    Bitboard enemy = state->bb_player[other_player(player)];
+    struct LegalityMasks masks = compute_legality_masks(state, player);
 
-    // Combine the captures and moves into one array, placing the captures first.
-    struct Move *combined_moves = malloc(sizeof(struct Move) * move_count);
-    int combined_idx = 0;
+    struct BoardPos *piece_list = player == WhitePlayer ? state->piece_list_white : state->piece_list_black;
+    for (int i = 0; i < 16; i++) {
+        struct BoardPos from = piece_list[i];
+        if (boardpos_eq(from, NULL_BOARDPOS)) continue;
+
+        struct Piece piece = get_piece(state, from);
+        int sq = bb_square(from);
+
+        // Candidate noisy destinations: attack squares holding an enemy piece, plus for pawns the
+        // en passant diagonals and promotion pushes.
+        Bitboard targets = 0;
+        switch (piece.type) {
+            case King:
+                targets = bb_king_attacks(sq) & enemy;
+                break;
+            case Queen:
+                targets = bb_queen_attacks(sq, occupancy) & enemy;
+                break;
+            case Rook:
+                targets = bb_rook_attacks(sq, occupancy) & enemy;
+                break;
+            case Bishop:
+                targets = bb_bishop_attacks(sq, occupancy) & enemy;
+                break;
+            case Knight:
+                targets = bb_knight_attacks(sq) & enemy;
+                break;
+            case Pawn: {
+                // Diagonal captures including en passant onto an empty square, which
+                // is_move_legal_masked validates against the en passant target files.
+                targets = bb_pawn_attacks(sq, player) & ~state->bb_player[player];
+
+                // A promotion push is also a noisy move: it changes the material balance.
+                int direction = player == BlackPlayer ? 1 : -1;
+                int promotion_rank = player == BlackPlayer ? 7 : 0;
+                if (from.rank + direction == promotion_rank) {
+                    targets |= bb_from_pos(BoardPos(from.file, promotion_rank)) & ~occupancy;
+                }
+                break;
+            }
+            default:
+                continue;
+        }
 
-    // If there is a principal variation place that first.
-    if (has_pvn) {
-        combined_moves[combined_idx++] = tp_entry.best_move;
+        // Check each candidate for legality.
+        while (targets) {
+            struct BoardPos check = bb_to_pos(bb_scan_forward(targets));
+            targets &= targets - 1;
+            if (is_move_legal_masked(state, (struct Move){from, check}, &masks)) {
+                int score = capture_score(state, (struct Move){from, check});
+
+                // Captures that lose material by static exchange evaluation are pruned from
+                // quiescence entirely: the side to move can stand pat instead, so searching
+                // QxP-defended style captures only inflates the tree.
+                if (score < 0) continue;
+
+                scores[captures_idx] = score;
+                captures[captures_idx++] = (struct Move){from, check};
+            }
+        }
     }
 
-    // Copy the captures first.
-    memcpy(&combined_moves[combined_idx], captures, captures_idx * sizeof(struct Move));
-    free(captures);
-    combined_idx += captures_idx;
+    // Trying the biggest wins first gives quiescence its cutoffs as early as possible.
+    sort_moves_by_score(captures, scores, captures_idx);
+
+    *moves_out = captures;
+    return captures_idx;
+}
+
+// The evaluation weight of each square a piece attacks (and is not blocked from by a friendly
+// piece), indexed by piece type. A cornered knight is worth real material less than a centralised
+// one; the queen gets the smallest weight as her square count swings the most.
+static const int MOBILITY_WEIGHTS[7] = {0, 0, 1, 2, 3, 4, 0};
+
+// Pawn structure weights: doubled pawns block each other and can never defend one another,
+// isolated pawns have no friendly pawn to ever defend them, and a passed pawn (no enemy pawn in
+// its front span) threatens to promote, increasingly so the further it has advanced.
+#define DOUBLED_PAWN_PENALTY 15
+#define ISOLATED_PAWN_PENALTY 12
+#define PASSED_PAWN_BONUS 20
+#define PASSED_PAWN_ADVANCE_BONUS 6
+
+// The score of a won KPK position (see the bitbase probe in position_value): decisive against
+// any drawn or material-even score, but below a queen so that actually promoting still reads as
+// progress. The advance bonus makes each pawn push an improvement within the won region.
+#define KPK_WIN_VALUE 750
+#define KPK_WIN_ADVANCE_BONUS 10
+
+// Returns the mobility value of `player`'s minor and major pieces: the weighted count of
+// attacked squares not occupied by friendly pieces. The attack sets come from the precomputed
+// tables and classical rays (see bitboard.c), so each piece costs a few table loads and a
+// popcount rather than a walk over the board.
+static int mobility_value(struct GameState *state, enum Player player) {
+    Bitboard own = state->bb_player[player];
+    Bitboard occupancy = state->bb_player[WhitePlayer] | state->bb_player[BlackPlayer];
+    int value = 0;
 
-    // Followed by the other moves.
-    memcpy(&combined_moves[combined_idx], moves, moves_idx * sizeof(struct Move));
-    free(moves);
-    combined_idx += moves_idx;
+    for (Bitboard bb = state->bb_type[Knight] & own; bb != 0; bb &= bb - 1) {
+        value += MOBILITY_WEIGHTS[Knight] * bb_popcount(bb_knight_attacks(bb_scan_forward(bb)) & ~own);
+    }
+    for (Bitboard bb = state->bb_type[Bishop] & own; bb != 0; bb &= bb - 1) {
+        value += MOBILITY_WEIGHTS[Bishop] * bb_popcount(bb_bishop_attacks(bb_scan_forward(bb), occupancy) & ~own);
+    }
+    for (Bitboard bb = state->bb_type[Rook] & own; bb != 0; bb &= bb - 1) {
+        value += MOBILITY_WEIGHTS[Rook] * bb_popcount(bb_rook_attacks(bb_scan_forward(bb), occupancy) & ~own);
+    }
+    for (Bitboard bb = state->bb_type[Queen] & own; bb != 0; bb &= bb - 1) {
+        value += MOBILITY_WEIGHTS[Queen] * bb_popcount(bb_queen_attacks(bb_scan_forward(bb), occupancy) & ~own);
+    }
 
-    *moves_out = combined_moves;
-    return move_count;
+    return value;
+}
+
+// Returns the pawn structure value of `player`'s pawns: penalties for doubled and isolated
+// pawns (found with per-file popcounts) and bonuses for passed pawns (no enemy pawn in the
+// front span mask), growing as the pawn advances.
+static int pawn_structure_value(struct GameState *state, enum Player player) {
+    Bitboard own_pawns = state->bb_type[Pawn] & state->bb_player[player];
+    Bitboard enemy_pawns = state->bb_type[Pawn] & state->bb_player[other_player(player)];
+    int value = 0;
+
+    for (int file = 0; file < 8; file++) {
+        Bitboard file_pawns = own_pawns & bb_file(file);
+        if (file_pawns == 0) continue;
+
+        int count = bb_popcount(file_pawns);
+        if (count > 1) value -= DOUBLED_PAWN_PENALTY * (count - 1);
+
+        Bitboard adjacent = 0;
+        if (file > 0) adjacent |= bb_file(file - 1);
+        if (file < 7) adjacent |= bb_file(file + 1);
+        if ((own_pawns & adjacent) == 0) value -= ISOLATED_PAWN_PENALTY * count;
+    }
+
+    for (Bitboard bb = own_pawns; bb != 0; bb &= bb - 1) {
+        int sq = bb_scan_forward(bb);
+        if ((bb_pawn_front_span(sq, player) & enemy_pawns) == 0) {
+            // Ranks advanced beyond the starting rank. White pawns start on rank 6 and advance
+            // towards rank 0, black pawns start on rank 1 and advance towards rank 7.
+            int advance = player == WhitePlayer ? 6 - sq / 8 : sq / 8 - 1;
+            value += PASSED_PAWN_BONUS + PASSED_PAWN_ADVANCE_BONUS * advance;
+        }
+    }
+
+    return value;
 }
 
 // Returns a value represeting how good a chess position is for white.
@@ -220,6 +688,32 @@ static unsigned int all_legal_moves_ordered(struct GameState *state, enum Player
 int position_value(struct GameState *state) {
     int value = 0;
 
+    // King and pawn versus king is solved exactly by the bitbase (see kpk.c): the search often
+    // cannot see the 20+ plies to promotion within its budget, while the probe knows the result
+    // of best play from any KPK position. Drawn positions score exactly 0 and won ones a
+    // decisive value that grows as the pawn advances, so the search both stops burning depth on
+    // dead draws and steers the won ones towards promotion, where the normal evaluation (now a
+    // queen up) takes over.
+    Bitboard kings = bb_from_pos(state->white_king) | bb_from_pos(state->black_king);
+    Bitboard pawns = state->bb_type[Pawn];
+    if (((state->bb_player[WhitePlayer] | state->bb_player[BlackPlayer]) ^ kings) == pawns &&
+        bb_popcount(pawns) == 1) {
+        int psq = bb_scan_forward(pawns);
+
+        if ((pawns & state->bb_player[WhitePlayer]) != 0) {
+            if (!kpk_probe(state->white_king, state->black_king, bb_to_pos(psq), state->white_to_move)) return 0;
+            return KPK_WIN_VALUE + KPK_WIN_ADVANCE_BONUS * (6 - psq / 8);
+        }
+
+        // A black pawn: flip the ranks and the side to move to reuse the white-oriented table.
+        struct BoardPos pawn = bb_to_pos(psq);
+        if (!kpk_probe(BoardPos(state->black_king.file, 7 - state->black_king.rank),
+                       BoardPos(state->white_king.file, 7 - state->white_king.rank),
+                       BoardPos(pawn.file, 7 - pawn.rank), !state->white_to_move))
+            return 0;
+        return -(KPK_WIN_VALUE + KPK_WIN_ADVANCE_BONUS * (psq / 8 - 1));
+    }
+
     // Being in check is bad, the enemy being in check is good.
     if (is_player_in_check(state, WhitePlayer)) {
         value -= 30;
@@ -227,70 +721,171 @@ int position_value(struct GameState *state) {
         value += 30;
     }
 
-    // Add the values for each piece on the board.
-    // Each piece type has a value associated with it, e.g. the value of a queen is greater than that of a pawn as the
-    // queen is much more powerful.
-    // The values for each piece type are stored in an array indexed by the (piece_type - 1).
-    static const int PIECE_VALUES[6] = {20000, 900, 500, 330, 320, 100};
-    for (int i = 0; i < 16; i++) {
-        // Add the sum of all the piece values for each white piece on the board.
-        if (!boardpos_eq(state->piece_list_white[i], NULL_BOARDPOS)) {
-            struct Piece piece = get_piece(state, state->piece_list_white[i]);
-            value += PIECE_VALUES[piece.type - 1];
-        }
-
-        // Subtract the sum of all the piece values for each black piece on the board.
-        if (!boardpos_eq(state->piece_list_black[i], NULL_BOARDPOS)) {
-            struct Piece piece = get_piece(state, state->piece_list_black[i]);
-            value -= PIECE_VALUES[piece.type - 1];
-        }
-    }
+    // Material and centre-control are maintained incrementally by put_piece as pieces move,
+    // are captured and promote, so the hottest part of the evaluation is just two adds here
+    // rather than a rescan of both piece lists and the central squares at every leaf.
+    value += state->material + state->psq;
 
     // Add value if white has castling rights, remove value if black has castling rights.
     value += state->white_castlert_left + state->white_castlert_right;
     value -= state->black_castlert_left + state->black_castlert_right;
 
     // The more 'safe' the king of a player is the less likely they are to be checkmated.
-    // Safety is measured by the number of friendly pieces each player has in the adjacent squares of their kings.
-    for (int i = 0; i < 8; i++) {
-        struct BoardPos direction = PIECE_MOVE_DIRECTIONS[King - 1][i];
-        struct BoardPos check_friendly = boardpos_add(state->white_king, direction);
-        struct BoardPos check_enemy = boardpos_add(state->black_king, direction);
-        if (!boardpos_eq(check_friendly, NULL_BOARDPOS)) {
-            struct Piece piece = get_piece(state, check_friendly);
-            // If there is a white piece adjacent to the white king then add value.
-            if (piece.type != Empty && piece.player == WhitePlayer) {
-                value += 10;
-            }
+    // Safety is measured by the number of friendly pieces in the adjacent squares of each king,
+    // one popcount per king against the precomputed king attack mask.
+    value += 10 * bb_popcount(bb_king_attacks(bb_square(state->white_king)) & state->bb_player[WhitePlayer]);
+    value -= 10 * bb_popcount(bb_king_attacks(bb_square(state->black_king)) & state->bb_player[BlackPlayer]);
+
+    // Mobility and pawn structure, from the bitboard kernels above.
+    value += mobility_value(state, WhitePlayer) - mobility_value(state, BlackPlayer);
+    value += pawn_structure_value(state, WhitePlayer) - pawn_structure_value(state, BlackPlayer);
+
+    return value;
+}
+
+// Quiescence search: evaluates a position by extending the search along captures and promotions
+// only, so the value returned never comes from the middle of a capture sequence (the "horizon
+// effect"). The player to move may always "stand pat" and take the static evaluation instead of
+// capturing, which gives the initial lower bound; alpha-beta pruning applies as in negamax.
+// Returns INT_MIN if the search ran out of time, like negamax.
+static int quiescence(struct GameState *state, int alpha, int beta, struct TimeManager *tm, struct Arena *arena) {
+    enum Player player = state->white_to_move ? WhitePlayer : BlackPlayer;
+
+    thread_stats.qnodes += 1;
+
+    // Quiescence nodes count towards the deadline check batches too - a single capture sequence
+    // can make up a large share of the tree, so without this the hard deadline can be overrun.
+    if (search_should_stop(tm)) return INT_MIN;
+
+    // The stand pat value: the player is assumed to be able to at least achieve the static
+    // evaluation by declining to capture (not true in zugzwang, but a standard approximation).
+    int best_value = position_value(state) * (player == WhitePlayer ? 1 : -1);
+    if (best_value >= beta) return best_value;
+    if (best_value > alpha) alpha = best_value;
+
+    // Search only the noisy moves, recursing until a quiet position is reached.
+    size_t node_mark = arena_mark(arena);
+    struct Move *captures;
+    unsigned int capture_count = all_legal_captures(state, player, &captures, arena);
+
+    for (unsigned int i = 0; i < capture_count; i++) {
+        struct MoveUndo undo;
+        make_move_undoable(state, captures[i], &undo, true);
+        int value = quiescence(state, -beta, -alpha, tm, arena);
+        unmake_move(state, &undo);
+
+        // Bubble the out-of-time sentinel up without negating it (negating INT_MIN overflows).
+        if (value == INT_MIN) {
+            arena_release(arena, node_mark);
+            return INT_MIN;
         }
+        value = -value;
 
-        if (!boardpos_eq(check_enemy, NULL_BOARDPOS)) {
-            struct Piece piece = get_piece(state, check_enemy);
-            // If there is a black piece adjacent to the black king then subtract value.
-            if (piece.type != Empty && piece.player == BlackPlayer) {
-                value -= 10;
+        if (value > best_value) {
+            best_value = value;
+            if (value > alpha) {
+                alpha = value;
             }
         }
+
+        if (alpha >= beta) {
+            break;
+        }
     }
 
-    // Controlling the centre of the board is advantageous in chess (due to better mobilty etc.).
-    // Each of the central squares are checked for the presence of each player's pieces.
-    for (int file = 2; file <= 5; file++) {
-        for (int rank = 2; rank <= 5; rank++) {
-            struct Piece piece = get_piece(state, BoardPos(file, rank));
-            if (piece.type == Empty) continue;
-
-            // Add value if white is in the centre, subtract value if black is in the centre.
-            // More value is added/subtracted for squares which are more central.
-            if (file == 2 || file == 5 || rank == 2 || rank == 5) {
-                value += piece.player == WhitePlayer ? 2 : -2;
-            } else {
-                value += piece.player == WhitePlayer ? 5 : -5;
-            }
+    arena_release(arena, node_mark);
+    return best_value;
+}
+
+// Returns true if the position is drawn by rule: the fifty-move rule (100 halfmoves without a
+// capture or pawn move) or a repetition of an earlier position in the game or search line.
+// Only positions since the last irreversible move can repeat, so the scan is bounded by the
+// halfmove clock rather than the length of the game - O(halfmove clock) per node with no
+// allocation, cheap enough to run on the search hot path.
+// A single repetition is treated as the draw: if repeating once is the best either side can do,
+// repeating twice more would be as well.
+static bool is_draw_by_rule(struct GameState *state) {
+    // Checkmate takes precedence over the fifty-move rule when they arrive on the same move, so
+    // the (rare) clock expiry has to confirm the player is not mated before declaring the draw.
+    if (state->halfmove_clock >= 100) {
+        return !is_player_checkmated(state, state->white_to_move ? WhitePlayer : BlackPlayer);
+    }
+
+    // A repetition has the same side to move, so it can only sit an even number of plies back,
+    // four at the earliest. The clock can exceed the recorded history when the game was loaded
+    // from a FEN with a nonzero halfmove clock, hence the MIN with move_count.
+    int limit = MIN(state->halfmove_clock, state->move_count);
+    for (int back = 4; back <= limit; back += 2) {
+        if (state->hash_history[(state->move_count - back) % HASH_HISTORY_MAX] == state->hash) {
+            return true;
         }
     }
 
-    return value;
+    return false;
+}
+
+// The depth subtracted (in addition to the usual one ply) when searching the "pass" reply in
+// null-move pruning. The reduced search only has to show the position is still above beta after
+// doing nothing, so it can be much shallower than the real search.
+#define NULL_MOVE_REDUCTION 2
+
+// Late move reductions: quiet moves ordered after the first LMR_FULL_DEPTH_MOVES moves of a node
+// are searched one ply shallower first, at depth LMR_MIN_DEPTH or more. The move ordering puts
+// the transposition table move, captures and killers first, so a late quiet move rarely beats
+// alpha - and when the reduced search shows one does, it is re-searched at full depth.
+#define LMR_FULL_DEPTH_MOVES 4
+#define LMR_MIN_DEPTH 3
+
+// The half-width of the aspiration window (in evaluation units, roughly centipawns) a deepening
+// iteration is first searched with, centred on the previous iteration's value, and the factor
+// the width grows by on every fail. See the deepening loop in movegen_task.
+#define ASPIRATION_WINDOW 40
+#define ASPIRATION_WIDEN_FACTOR 4
+
+// What a null move changes: everything a "pass" cannot alter (the board, castling rights, check
+// flags) is left alone, so much less needs saving than for a real move.
+struct NullUndo {
+    ZobristHash hash;               // Previous zobrist hash
+    int8_t enpassant_target_white;  // Previous en passant target files
+    int8_t enpassant_target_black;  //
+    int halfmove_clock;             // Previous halfmove clock
+};
+
+// Gives the move to the opponent without moving ("passes"), for null-move pruning. Any en passant
+// right expires exactly as it would after a real non-double-push move. The pre-move hash is
+// recorded in the history ring like make_move does, so repetition scans below the null read a
+// valid slot.
+static void make_null_move(struct GameState *state, struct NullUndo *undo) {
+    undo->hash = state->hash;
+    undo->enpassant_target_white = state->enpassant_target_white;
+    undo->enpassant_target_black = state->enpassant_target_black;
+    undo->halfmove_clock = state->halfmove_clock;
+
+    state->hash_history[state->move_count % HASH_HISTORY_MAX] = state->hash;
+    state->halfmove_clock += 1;
+
+    // Strip the en passant contribution, expire the rights, then toggle the side to move in the
+    // state and the hash (see make_move for why the en passant part cannot be a plain XOR).
+    ZobristHash hash = state->hash ^ zobrist_enpassant_part(state);
+    state->enpassant_target_white = -1;
+    state->enpassant_target_black = -1;
+    state->move_count += 1;
+    state->white_to_move = !state->white_to_move;
+    hash = zobrist_toggle_white_to_move(hash);
+    state->hash = hash ^ zobrist_enpassant_part(state);
+
+    // Cross-check the incremental update against a full rehash in debug builds, like make_move.
+    assert(state->hash == hash_state(state));
+}
+
+// Reverses make_null_move.
+static void unmake_null_move(struct GameState *state, const struct NullUndo *undo) {
+    state->white_to_move = !state->white_to_move;
+    state->move_count -= 1;
+    state->enpassant_target_white = undo->enpassant_target_white;
+    state->enpassant_target_black = undo->enpassant_target_black;
+    state->halfmove_clock = undo->halfmove_clock;
+    state->hash = undo->hash;
 }
 
 // Evaluates the current position, returning a value representing how good the position is for the player to move.
@@ -298,19 +893,31 @@ int position_value(struct GameState *state) {
 // the postition by calling position_value.
 // Alpha-beta pruning is used to improve performance by 'pruning' branches in the game tree to avoid unneeded
 // computation.
-static int negamax(struct GameState *state, int alpha, int beta, int depth, time_t start_time) {
+// `ply` is the distance from the root, used to index the killer move slots.
+static int negamax(struct GameState *state, int alpha, int beta, int depth, int ply, struct TimeManager *tm,
+                   struct Arena *arena) {
     enum Player player = state->white_to_move ? WhitePlayer : BlackPlayer;
 
     // The alpha value at the start of this node evaluation is stored so it can be compared the the evaluation value
     // later to detect if it failed low.
     int start_alpha = alpha;
 
+    thread_stats.nodes += 1;
+
+    // Score draws by repetition or the fifty-move rule immediately. This must run before the
+    // transposition table probe: a stored value for this hash knows nothing about the moves which
+    // led here, and would otherwise let the engine shuffle a winning position into a repetition.
+    if (is_draw_by_rule(state)) return 0;
+
     // Check the transposition table if we have already evaluated the position at a greater or equal depth then we would
     // be evaluating it now. So that the value can be reused, improving performance.
     struct TranspositionEntry tp_entry = tptable_get(state->hash);
+    thread_stats.tt_probes += 1;
+    if (tp_entry.depth != 0) thread_stats.tt_hits += 1;
     if (tp_entry.depth != 0 && tp_entry.depth >= depth) {
         if (tp_entry.type == EntryTypeExact) {
             // We have the exact value of this position, return it.
+            thread_stats.tt_cutoffs += 1;
             return tp_entry.value;
         } else if (tp_entry.type == EntryTypeLower) {
             // We have a lower bound on the value of this postition, assign it to alpha so that more cutoffs can occur.
@@ -329,6 +936,7 @@ static int negamax(struct GameState *state, int alpha, int beta, int depth, time
         // player than a previously evaluated branch, so the minimising player will choose the previously evaluated
         // branch regardless and the value of this node does not matter.
         if (alpha >= beta) {
+            thread_stats.tt_cutoffs += 1;
             return tp_entry.value;
         }
     }
@@ -345,11 +953,34 @@ static int negamax(struct GameState *state, int alpha, int beta, int depth, time
         return 0;
     }
 
-    // Return the position value if we have no more depth to search.
-    if (depth == 0) return position_value(state) * (player == WhitePlayer ? 1 : -1);
-
-    // If the maximum amount of time that can be spent on move generation has elapsed then return now.
-    if (time(NULL) - start_time >= MAX_MOVEGEN_SEARCH_TIME) return INT_MIN;
+    // When there is no more depth to search, resolve the position with a quiescence search so the
+    // value does not come from the middle of a capture sequence.
+    if (depth == 0) return quiescence(state, alpha, beta, tm, arena);
+
+    // If the search has run out of time (or was told to stop) then return now.
+    if (search_should_stop(tm)) return INT_MIN;
+
+    bool in_check = player == WhitePlayer ? state->white_king_in_check : state->black_king_in_check;
+
+    // Null-move pruning: if passing (an illegal "move" which only hands the opponent the turn)
+    // still leaves the position above beta after a reduced search, an actual move almost
+    // certainly would too, and the node can fail high without a move loop. The assumption that
+    // some real move is at least as good as passing fails in zugzwang, so the pruning is skipped
+    // when it is most likely: when the player is in check or has only pawns left (the guard uses
+    // the occupancy bitboards, so it is a couple of ANDs). Mate bounds are also excluded - a null
+    // search cannot prove a forced mate.
+    if (depth > NULL_MOVE_REDUCTION && !in_check && beta < 1000000 &&
+        (state->bb_player[player] &
+         (state->bb_type[Queen] | state->bb_type[Rook] | state->bb_type[Bishop] | state->bb_type[Knight])) != 0) {
+        struct NullUndo null_undo;
+        make_null_move(state, &null_undo);
+        // A zero-width window around beta: only whether the value is above beta matters here.
+        int null_value = negamax(state, -beta, -beta + 1, depth - 1 - NULL_MOVE_REDUCTION, ply + 1, tm, arena);
+        unmake_null_move(state, &null_undo);
+
+        if (null_value == INT_MIN) return INT_MIN;
+        if (-null_value >= beta) return -null_value;
+    }
 
     // Setup the transposition table entry, to be added at the end of the evaluation.
     if (tp_entry.depth == 0) {
@@ -364,18 +995,36 @@ static int negamax(struct GameState *state, int alpha, int beta, int depth, time
 
     // Get a list of every legal move from this position for the player, and order them using a heuristic so that better
     // moves are ideally first. Alpga-beta pruning performs better if the better moves are first as more beta cutoffs
-    // can occur.
+    // can occur. The list lives in the arena until this node exits.
+    size_t node_mark = arena_mark(arena);
     struct Move *legal_moves;
-    unsigned int move_count = all_legal_moves_ordered(state, player, &legal_moves);
+    unsigned int move_count = all_legal_moves_ordered(state, player, &legal_moves, arena, ply);
 
     // Evaluate each of the moves to find the move with the best value.
     for (unsigned int i = 0; i < move_count; i++) {
         struct Move move = legal_moves[i];
 
-        // A copy of the GameState is created so that the move can be made on it temporarily while it is being
-        // evaluated.
-        struct GameState *state_copy = copy_gamestate(state);
-        make_move(state_copy, move, true);
+        // The move is made in place, recording undo information so the state can be restored after
+        // the move has been evaluated. This avoids allocating and copying a state at every node.
+        struct MoveUndo undo;
+        make_move_undoable(state, move, &undo, true);
+
+        // Late move reduction: a quiet move this late in the ordering is unlikely to beat alpha,
+        // so it is first searched one ply shallower with a zero-width window, which is enough to
+        // confirm it fails low. The reduction is skipped for captures and promotions, for moves
+        // made while in check or giving check, and whenever the shallow search suggests the move
+        // is better than expected after all - then the full-depth search below runs as normal.
+        bool reduce = i >= LMR_FULL_DEPTH_MOVES && depth >= LMR_MIN_DEPTH && !in_check &&
+                      undo.captured_piece.type == Empty &&
+                      !(undo.moved_piece.type == Pawn && (move.to.rank == 0 || move.to.rank == 7)) &&
+                      !(state->white_to_move ? state->white_king_in_check : state->black_king_in_check);
+        int value = INT_MIN;
+        if (reduce) {
+            value = negamax(state, -alpha - 1, -alpha, depth - 2, ply + 1, tm, arena);
+            // The move beat alpha at the reduced depth, so the assumption behind reducing it was
+            // wrong; fall through to the full-depth search to get its real value.
+            if (value != INT_MIN && -value > alpha) value = INT_MIN;
+        }
 
         // Negamax is recursively called to evaluate the position after the move has been made.
         // The properties `min(a, b) === -max(-a, -b)` and `max(a, b) === -min(-a, -b)` are used to allow the same
@@ -383,15 +1032,15 @@ static int negamax(struct GameState *state, int alpha, int beta, int depth, time
         // the best value the maximising player is negated to become beta, the best value the minimising player has and
         // vice versa.
         // In each call of negamax the player to move changes, so alpha, beta and the return values are negated.
-        int value = negamax(state_copy, -beta, -alpha, depth - 1, start_time);
+        if (value == INT_MIN) value = negamax(state, -beta, -alpha, depth - 1, ply + 1, tm, arena);
 
-        // The position has been evaluated and the temporary copy is no longer needed.
-        free(state_copy);
+        // The position has been evaluated, restore the state.
+        unmake_move(state, &undo);
 
         // INT_MIN is returned when the move generation time limit is reached. The value we be bubbled up so it is
         // detected by negamax_from_root.
         if (value == INT_MIN) {
-            free(legal_moves);
+            arena_release(arena, node_mark);
             return INT_MIN;
         }
 
@@ -418,11 +1067,18 @@ static int negamax(struct GameState *state, int alpha, int beta, int depth, time
         // position as the 'minimising' player will always choose the other branch which we know to be lower than the
         // minimum value this node can be.
         if (alpha >= beta) {
+            thread_stats.beta_cutoffs += 1;
+            if (i == 0) thread_stats.beta_cutoffs_first += 1;
+
+            // Remember quiet moves that caused the cutoff so the ordering tries them earlier next time.
+            if (undo.captured_piece.type == Empty) {
+                record_quiet_cutoff(player, move, depth, ply);
+            }
             break;
         }
     }
 
-    free(legal_moves);
+    arena_release(arena, node_mark);
 
     // If best_value is still INT_MIN that means no legal moves were found. But if there are no legal moves that means
     // it is either checkmate or stalemate, which should have been detected earlier in the function.
@@ -456,42 +1112,159 @@ static int negamax(struct GameState *state, int alpha, int beta, int depth, time
     return best_value;
 }
 
-// Used for testing
+// The piece types a pawn can promote to besides a queen.
+static const enum PieceType UNDERPROMOTIONS[3] = {Rook, Bishop, Knight};
+
+// Recomputes the in-check flags from the board, used after perft replaces a promoted piece in
+// place (the different promotion pieces give check from different squares).
+static void recompute_check_flags(struct GameState *state) {
+    state->white_king_in_check = is_piece_attacked(state, state->white_king, BlackPlayer);
+    state->black_king_in_check = is_piece_attacked(state, state->black_king, WhitePlayer);
+}
+
+// Counts the leaf nodes of the legal move tree to `depth`, used to validate the move generator
+// and measure its throughput (see the chess-perft target).
 // https://www.chessprogramming.org/Perft
-// NOTE only queen promotions are counted, so results will be lower if there are promotion moves
-// static uint64_t perft(struct GameState *state, int depth, enum Player player) {
-//     if (depth == 0) return 1ULL;
-
-//     uint64_t nodes = 0;
-//     struct Move *legal_moves = all_legal_moves_ordered(state, player);
-//     for (int i = 0; !boardpos_eq(legal_moves[i].from, NULL_BOARDPOS); i++) {
-//         struct Move move = legal_moves[i];
-
-//         struct GameState *state_copy = copy_gamestate(state);
-//         make_move(state_copy, move.from, move.to);
-//         nodes += perft(state_copy, depth - 1, other_player(player));
-//         free(state_copy);
-//     }
-
-//     free(legal_moves);
-//     return nodes;
-// }
-
-// Returns the best move for the player to move from the current position. Calls negamax to evaluate each possible move,
-// and returns the best. Returns a Move with NULL_BOARDPOS as the `from` if the time limit was reached or there are no
-// legal moves.
-static void negamax_from_root(struct GameState *state, int depth, time_t start_time) {
-    // Inititalise alpha and beta to the starting values.
-    // In the alpha-beta pruning algorithm alpha is used to store the best value the maximising player has so far and
-    // beta is used to store the best value the minimising player has so far.
-    // So, alpha is initialised to the worst possible value for the maximising player (actually INT_MIN + 1 to avoid
-    // signed integer overflow on negation) and beta is initialised to the worst possible value for the minimising
-    // player.
-    int alpha = INT_MIN + 1;
-    const int beta = INT_MAX;
+// All four promotion pieces are counted: make_move always promotes to a queen, so the rook,
+// bishop and knight subtrees are counted by replacing the promoted queen in place (which changes
+// nothing else a move depends on, apart from the in-check flags which are recomputed).
+uint64_t perft(struct GameState *state, int depth) {
+    if (depth == 0) return 1ULL;
+
+    enum Player player = state->white_to_move ? WhitePlayer : BlackPlayer;
+
+    struct Arena *arena = get_search_arena();
+    size_t node_mark = arena_mark(arena);
+    struct Move *legal_moves;
+    unsigned int move_count = all_legal_moves_ordered(state, player, &legal_moves, arena, 0);
+
+    uint64_t nodes = 0;
+    for (unsigned int i = 0; i < move_count; i++) {
+        struct Move move = legal_moves[i];
+        bool promotion =
+            get_piece(state, move.from).type == Pawn && (move.to.rank == 0 || move.to.rank == 7);
+
+        // The hash is not maintained: perft never probes the transposition table.
+        struct MoveUndo undo;
+        make_move_undoable(state, move, &undo, false);
+        nodes += perft(state, depth - 1);
+
+        if (promotion) {
+            for (int p = 0; p < 3; p++) {
+                put_piece(state, Piece(UNDERPROMOTIONS[p], player), move.to);
+                recompute_check_flags(state);
+                nodes += perft(state, depth - 1);
+            }
+        }
+
+        unmake_move(state, &undo);
+    }
+
+    arena_release(arena, node_mark);
+    return nodes;
+}
+
+struct PerftTaskArg {
+    struct GameState state;  // The position after one root move
+    int depth;               // The remaining depth below the root move
+    uint64_t *nodes_out;     // Where the subtree count is written
+};
+
+// Task counting the subtree below one root move. See perft_parallel.
+static void perft_task(struct PerftTaskArg *arg) {
+    *arg->nodes_out = perft(&arg->state, arg->depth);
+    free(arg);
+}
+
+// perft with the subtrees below the root moves counted in parallel on the thread pool (each task
+// gets its own copy of the position, and the search arenas are already per-thread). Blocks until
+// every subtree has been counted; without C11 threads the tasks run sequentially inline.
+uint64_t perft_parallel(struct GameState *state, int depth, struct ThreadPool *pool) {
+    if (depth == 0) return 1ULL;
+
+    enum Player player = state->white_to_move ? WhitePlayer : BlackPlayer;
+
+    struct Arena *arena = get_search_arena();
+    size_t node_mark = arena_mark(arena);
+    struct Move *legal_moves;
+    unsigned int move_count = all_legal_moves_ordered(state, player, &legal_moves, arena, 0);
+
+    // Each root move spawns one task, plus one per underpromotion. The counts are written to
+    // separate slots so the tasks never contend.
+    uint64_t *counts = malloc(sizeof(uint64_t) * move_count * 4);
+    size_t task_count = 0;
+    struct TaskBatch batch;
+    taskbatch_init(&batch);
+
+    for (unsigned int i = 0; i < move_count; i++) {
+        struct Move move = legal_moves[i];
+        bool promotion =
+            get_piece(state, move.from).type == Pawn && (move.to.rank == 0 || move.to.rank == 7);
+
+        struct MoveUndo undo;
+        make_move_undoable(state, move, &undo, false);
+
+        int variations = promotion ? 4 : 1;
+        for (int p = 0; p < variations; p++) {
+            if (p > 0) {
+                put_piece(state, Piece(UNDERPROMOTIONS[p - 1], player), move.to);
+                recompute_check_flags(state);
+            }
+
+            // Freed by the task.
+            struct PerftTaskArg *arg = malloc(sizeof(*arg));
+            memcpy(&arg->state, state, sizeof(arg->state));
+            arg->depth = depth - 1;
+            arg->nodes_out = &counts[task_count++];
+            threadpool_submit(pool, (TaskFunc)perft_task, arg, &batch);
+        }
+
+        unmake_move(state, &undo);
+    }
+
+    arena_release(arena, node_mark);
+
+    // Wait for the tasks to finish.
+    threadpool_wait(pool, &batch);
+
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < task_count; i++) {
+        nodes += counts[i];
+    }
+
+    free(counts);
+    return nodes;
+}
+
+// Searches the position to `depth` plies, evaluating each root move with negamax inside the
+// `(alpha, beta)` window (the deepening loop passes an aspiration window around the previous
+// iteration's value, or the full window `(INT_MIN + 1, INT_MAX)`). Returns the best value found,
+// which is only trustworthy inside the window: a value at or outside a bound means the window
+// was wrong and the iteration must be re-searched wider. Returns INT_MIN if the search ran out
+// of time.
+// If `publish_root` is true and the search completed with a value inside the window, the best
+// root move is stored in the transposition table and the completion mailbox where
+// generate_move's caller picks it up; helper workers search with publish_root false and
+// contribute only through the entries their searches leave in the shared table.
+// A published result is also written to `result_out` when it is not NULL, which lets a
+// synchronous caller (search_fixed_depth) collect it without reading the mailbox back - the
+// mailbox is global, so a concurrent search for another position can overwrite it in between.
+// Such callers report their own results, so the progress line goes only to the timed searches.
+static int negamax_from_root(struct GameState *state, int alpha, int beta, int depth, struct TimeManager *tm,
+                             bool publish_root, struct SearchResult *result_out) {
+    const int start_alpha = alpha;
 
     enum Player player = state->white_to_move ? WhitePlayer : BlackPlayer;
 
+    // The root state is shared (read-only) between the concurrent iterative deepening tasks, so a
+    // private copy is made once here for the search to make and unmake moves on in place. The
+    // copy and all the search's move lists live in this thread's arena and are released together
+    // when the search returns.
+    struct Arena *arena = get_search_arena();
+    size_t root_mark = arena_mark(arena);
+    struct GameState *search_state = arena_alloc(arena, sizeof(*search_state));
+    memcpy(search_state, state, sizeof(*search_state));
+
     // The best move found will be stored so it can be returned.
     struct Move best_move = (struct Move){NULL_BOARDPOS, NULL_BOARDPOS};
 
@@ -502,17 +1275,15 @@ static void negamax_from_root(struct GameState *state, int depth, time_t start_t
     // moves are ideally first. Alpha-beta pruning performs better if the better moves are first as more beta cutoffs
     // can occur.
     struct Move *legal_moves;
-    unsigned int move_count = all_legal_moves_ordered(state, player, &legal_moves);
+    unsigned int move_count = all_legal_moves_ordered(search_state, player, &legal_moves, arena, 0);
 
     // Every legal move is evaluated and compared to find the move with the highest value, the best move for the player.
     for (unsigned int i = 0; i < move_count; i++) {
         struct Move move = legal_moves[i];
 
-        // A copy of the state is created so the current state is not affected by the move.
-        struct GameState *state_copy = copy_gamestate(state);
-
-        // Make the move
-        make_move(state_copy, move, true);
+        // Make the move in place, recording the undo information so it can be reversed.
+        struct MoveUndo undo;
+        make_move_undoable(search_state, move, &undo, true);
 
         // Negamax is called to evaluate the position after the move has been made.
         // The properties `min(a, b) === -max(-a, -b)` and `max(a, b) === -min(-a, -b)` are used to allow the same
@@ -520,13 +1291,13 @@ static void negamax_from_root(struct GameState *state, int depth, time_t start_t
         // the best value the maximising player is negated to become beta, the best value the minimising player has and
         // vice versa.
         // In each call of negamax the player to move changes, so alpha, beta and the return values are negated.
-        int value = negamax(state_copy, -beta, -alpha, depth - 1, start_time);
-        free(state_copy);
+        int value = negamax(search_state, -beta, -alpha, depth - 1, 1, tm, arena);
+        unmake_move(search_state, &undo);
 
         // INT_MIN is returned when the time limit is reached.
         if (value == INT_MIN) {
-            free(legal_moves);
-            return;
+            arena_release(arena, root_mark);
+            return INT_MIN;
         }
 
         // The value returned by negamax is relative to the player to move (greater values are better for the player to
@@ -546,11 +1317,19 @@ static void negamax_from_root(struct GameState *state, int depth, time_t start_t
                 alpha = value;
             }
         }
+
+        // A root move can fail high against an aspiration window; the remaining moves cannot
+        // change the fact that the window was too low, so stop and let the caller re-search.
+        if (alpha >= beta) break;
     }
 
-    free(legal_moves);
+    arena_release(arena, root_mark);
 
-    if (!boardpos_eq(best_move.from, NULL_BOARDPOS)) {
+    // A value at or outside a window bound is only a bound on the real value and the best move
+    // which produced it cannot be trusted, so such iterations are not published; the caller
+    // re-searches at the same depth with a wider window straight away.
+    if (publish_root && best_value > start_alpha && best_value < beta &&
+        !boardpos_eq(best_move.from, NULL_BOARDPOS)) {
         // Add the principal variation (best move) to the transposition table, so that it can be used in move
         // ordering and by generate_move.
         struct TranspositionEntry entry = tptable_get(state->hash);
@@ -560,48 +1339,165 @@ static void negamax_from_root(struct GameState *state, int depth, time_t start_t
         entry.value = best_value;
         entry.type = EntryTypeExact;
         tptable_put(entry);
-        printf("[movegen] **** %d %d\n", depth, best_value);
+        search_result_publish(state->hash, best_move, best_value, depth);
+        thread_stats.depth = depth;
+        if (result_out != NULL) {
+            result_out->best_move = best_move;
+            result_out->value = best_value;
+            result_out->depth = depth;
+        } else {
+            printf("[movegen] **** %d %d\n", depth, best_value);
+        }
     }
+
+    return best_value;
 }
 
+// The shared state of one generate_move search, owned jointly by its workers. The last worker to
+// finish frees it (refcounted, as the caller may have returned long before).
+// The time manager is owned by the frontend, not by the workers, so the frontend can poll the
+// stop flag after the workers have finished.
+struct MovegenShared {
+    struct AtomicCounter *refcount;  // Counts the workers still running
+    struct GameState *state;         // Copy of the root position, read-only during the search
+    struct TimeManager *tm;          // The time budget for the search, owned by the caller
+};
+
 struct MovegenTaskArg {
-    struct AtomicCounter *refcount;  // Refcount of state and legal_moves.
-    struct GameState *state;
-    struct Move *legal_moves;
-    unsigned int move_count;
-    int depth;
-    time_t start_time;
+    struct MovegenShared *shared;
+    int worker_index;  // 0 is the main worker which publishes the root results
 };
 
-// Task executed the thread pool to perform move generation.
-// See generate_move.
-static bool movegen_task(struct MovegenTaskArg *arg) {
-    negamax_from_root(arg->state, arg->depth, arg->start_time);
+// One Lazy SMP worker: a full iterative deepening loop over the shared position.
+// Worker 0 is the main worker: it owns time management - its loop ends at the soft deadline (or
+// when an iteration hits the hard deadline), it publishes the best root move after each completed
+// depth, and it sets the stop flag when it is done, which aborts the helpers and tells the
+// frontend the move is ready. The helpers run the same loop with a staggered starting depth, so
+// at any moment different workers search different depths and fill the shared transposition table
+// with entries the main worker's deeper iterations reuse.
+static void movegen_task(struct MovegenTaskArg *arg) {
+    struct MovegenShared *shared = arg->shared;
+    struct TimeManager *tm = shared->tm;
+    bool is_main = arg->worker_index == 0;
+
+    // Odd-numbered helpers start one ply deeper than the main worker.
+    int first_depth = 1 + arg->worker_index % 2;
+
+    // The value of this worker's last completed iteration, around which the next iteration's
+    // aspiration window is centred. The first iteration has nothing to centre on and searches
+    // the full window.
+    int prev_value = 0;
+    bool have_prev = false;
+
+    // Whether this worker saw the stop flag set during the search. The flag doubles as the
+    // completion signal to the caller, and once the caller has seen it set it may reuse the
+    // TimeManager struct for its next search - so after observing it this worker must not touch
+    // the struct's flag again (see the completion signalling below).
+    bool observed_stop = false;
+
+    for (int depth = first_depth; depth <= MAX_SEARCH_DEPTH; depth++) {
+        if (observed_stop || (observed_stop = timeman_stopped(tm)) || timeman_soft_expired(tm)) break;
+
+        // Aspiration windows: consecutive iterations rarely change the root value by much, so
+        // searching inside a narrow window around the previous value causes cutoffs throughout
+        // the tree which the full window would not. The price is that a value at or outside a
+        // bound proves nothing but the bound itself, and the iteration has to be re-searched
+        // with that side of the window widened until the value lands inside.
+        int delta = ASPIRATION_WINDOW;
+        int alpha = have_prev ? MAX(prev_value - delta, INT_MIN + 1) : INT_MIN + 1;
+        int beta = have_prev ? MIN(prev_value + delta, INT_MAX) : INT_MAX;
+
+        for (;;) {
+            int value = negamax_from_root(shared->state, alpha, beta, depth, tm, is_main, NULL);
+            if (value == INT_MIN) {
+                // Out of time. The sentinel is only returned once the stop flag is set (the hard
+                // deadline sets it), so the flag has been observed set by this search.
+                observed_stop = true;
+                break;
+            }
 
-    if (acnt_dec(arg->refcount)) {
-        free(arg->refcount);
-        free(arg->state);
-        free(arg->legal_moves);
+            if (value <= alpha) {
+                // Failed low: widen downwards around the value it failed against. Once delta has
+                // grown past any plausible static evaluation, open the bound fully - mate scores
+                // sit far outside every window this loop would otherwise try.
+                delta *= ASPIRATION_WIDEN_FACTOR;
+                alpha = delta > ROUGH_MAX_POSITION_VALUE ? INT_MIN + 1 : value - delta;
+            } else if (value >= beta) {
+                // Failed high: widen upwards.
+                delta *= ASPIRATION_WIDEN_FACTOR;
+                beta = delta > ROUGH_MAX_POSITION_VALUE ? INT_MAX : value + delta;
+            } else {
+                prev_value = value;
+                have_prev = true;
+                break;
+            }
+        }
+
+        // Fold this iteration's counts into the shared totals. The stop flag can be set by the
+        // hard deadline in the middle of an iteration, and the caller reads the totals as soon as
+        // it sees the flag - flushing per iteration bounds what such a read can miss to the
+        // iteration in progress.
+        search_stats_flush();
+    }
+
+    // The main worker stamps the wall time of the whole search; the helpers leave it zero and the
+    // flush keeps the maximum. The flush must happen before the stop flag is set: the caller reads
+    // the totals as soon as it sees the flag, so flushing after it would race (the helpers may
+    // still add their counts afterwards, which only makes a prompt read an undercount).
+    if (is_main) thread_stats.elapsed_ms = timeman_elapsed_ms(tm);
+    search_stats_flush();
+
+    // Signal completion - but only if the flag was not observed set already. The flag doubles as
+    // the abort signal: the hard deadline sets it from inside an aborted iteration, and the
+    // caller, treating it as completion, may start its next search on the same TimeManager
+    // struct (resetting the flag) before this worker has unwound. A blind store here would then
+    // stop that next search at birth. If this worker never observed the flag the caller is
+    // still waiting on it, so setting it is safe; re-reading the flag here instead would race
+    // the caller's reset.
+    if (is_main && !observed_stop) timeman_stop(tm);
+
+    if (acnt_dec(shared->refcount)) {
+        free(shared->refcount);
+        free(shared->state);
+        free(shared);
     }
 
     free(arg);
-    return true;
 }
 
 // Generate the best move for the player to move, using negamax with iterative deepening and Lazy SMP on supported
 // systems.
 // The best move will be stored in the transposition table.
+// `tm` is started here with the given soft/hard time limits (milliseconds) and its stop flag is
+// set when the search finishes, so the caller can poll timeman_stopped to learn the move is
+// ready. It must outlive the search.
+// The stop flag can be set (by the hard deadline) while workers are still unwinding, and those
+// workers keep reading `tm` until they exit - so a caller which wants to reuse `tm` for another
+// search as soon as it sees the flag must pass a `batch` (initialised with taskbatch_init) and
+// block on threadpool_wait first; the workers are submitted under it. Callers with a natural gap
+// before the next search (the GUI) can pass NULL.
 // On systems with multithreading support the function will not block.
-void generate_move(struct GameState *state, struct ThreadPool *pool, time_t start_time) {
-    // Prevent entries for this hash being replaced by other hashes.
-    tptable_set_protected_hash(state->hash);
+void generate_move_timed(struct GameState *state, struct ThreadPool *pool, struct TimeManager *tm,
+                         int64_t soft_limit_ms, int64_t hard_limit_ms, struct TaskBatch *batch) {
+    timeman_start(tm, soft_limit_ms, hard_limit_ms);
+
+    // Entries written by this search belong to a new generation, so replacement in the
+    // transposition table prefers evicting leftovers of earlier searches.
+    tptable_new_search();
+
+    // Start the statistics of this search from zero. A helper of the previous search which has
+    // not yet noticed the stop flag may still flush a few thousand nodes into the new totals;
+    // this is diagnostics, so that small distortion is not worth synchronising away.
+    total_stats_lock();
+    memset(&total_stats, 0, sizeof(total_stats));
+    total_stats_unlock();
 
     // Check if there is a move available in the opening book if we are on move <= 5.
     if (state->move_count <= 5) {
-        struct OpeningItem *opening = find_opening_by_hash(state->hash);
-        if (opening) {
+        struct OpeningItem opening;
+        if (find_opening_by_hash(state->hash, &opening)) {
             // If there are multiple moves available then one is chosen at random.
-            struct Move move = opening->moves[rand() % opening->moves_count];
+            struct Move move = opening.moves[rand() % opening.moves_count];
 
             // Ensure the move is legal to reduce the impact of Zobrist hash collisions.
             if (is_move_legal(state, move)) {
@@ -612,22 +1508,13 @@ void generate_move(struct GameState *state, struct ThreadPool *pool, time_t star
                 entry.value = 0;
                 entry.type = EntryTypeExact;
                 tptable_put(entry);
+                search_result_publish(state->hash, move, 0, CHAR_MAX);
+                timeman_stop(tm);
                 return;
             }
         }
     }
 
-    // The threads will need a copy of the gamestate incase it is deallocated.
-    struct GameState *state_for_threads = copy_gamestate(state);
-
-    // Find the legal moves now to avoid doing it on each thread.
-    struct Move *legal_moves;
-    unsigned int move_count =
-        all_legal_moves_ordered(state, state->white_to_move ? WhitePlayer : BlackPlayer, &legal_moves);
-
-    // Counts references to the legal moves and the copied gamestate.
-    struct AtomicCounter *refcount = acnt_init(MAX_SEARCH_DEPTH);
-
     // Use iterative deepening to find the best move.
     // Initially the searching algorithm is ran with a low maximum depth. This depth is iteratively increased and the
     // algorithm is reran, until a time limit is reached. The result from the last completed search is used as the best
@@ -636,20 +1523,96 @@ void generate_move(struct GameState *state, struct ThreadPool *pool, time_t star
     // The performance effect of rerunning the algorithm multiple times instead of running it once is minimised as a
     // transposition table is used to store the results of previous evaluations, and the principal variation is stored
     // which is used in move ordering to improve alpha-beta pruning performance.
-    for (int depth = 1; depth <= MAX_SEARCH_DEPTH; depth++) {
-        // Freed by thread
+    //
+    // One worker per pool thread runs its own deepening loop over a shared copy of the position
+    // (Lazy SMP - see movegen_task); without C11 threads a single worker runs synchronously here.
+    size_t worker_count = MAX(threadpool_thread_count(pool), 1);
+
+    // Freed by the last worker to finish.
+    struct MovegenShared *shared = malloc(sizeof(*shared));
+    shared->refcount = acnt_init(worker_count);
+    shared->state = copy_gamestate(state);
+    shared->tm = tm;
+
+    for (size_t i = 0; i < worker_count; i++) {
+        // Freed by the worker.
         struct MovegenTaskArg *arg = malloc(sizeof(*arg));
-        arg->state = state_for_threads;
-        arg->depth = depth;
-        arg->start_time = start_time;
-        arg->legal_moves = legal_moves;
-        arg->move_count = move_count;
-        arg->refcount = refcount;
-
-        threadpool_enqueue(pool, (TaskFunc)movegen_task, arg);
+        arg->shared = shared;
+        arg->worker_index = (int)i;
+
+        threadpool_submit(pool, (TaskFunc)movegen_task, arg, batch);
     }
 }
 
+// generate_move_timed with the configured default time budget.
+void generate_move(struct GameState *state, struct ThreadPool *pool, struct TimeManager *tm) {
+    generate_move_timed(state, pool, tm, MOVEGEN_SOFT_TIME_MS, MOVEGEN_HARD_TIME_MS, NULL);
+}
+
+// An effectively unlimited time budget for fixed-depth searches: large enough to never expire,
+// small enough that adding it to a clock reading cannot overflow.
+#define SEARCH_NO_TIME_LIMIT_MS (INT64_C(1) << 40)
+
+// Searches the position to exactly `max_depth` plies of iterative deepening on the calling
+// thread, with no time limit, no helper workers and no opening book. Because nothing depends on
+// the clock or on thread scheduling, every run of the same position at the same depth visits
+// exactly the same nodes - which is what the bench and EPD drivers (bench.c) need to produce
+// comparable numbers; a time-limited search cuts the tree wherever the deadline happens to fall.
+// The killer move slots are cleared on entry so the node counts do not depend on whatever was
+// searched earlier on this thread; for the same reason callers wanting independent runs should
+// clear the transposition table first.
+// The result of the deepest completed iteration is written to `result_out` (best_move is
+// NULL_BOARDPOS if there are no legal moves); the node counters go to the search statistics,
+// exactly as a timed search would.
+void search_fixed_depth(struct GameState *state, int max_depth, struct SearchResult *result_out) {
+    result_out->best_move = (struct Move){NULL_BOARDPOS, NULL_BOARDPOS};
+    result_out->value = 0;
+    result_out->depth = 0;
+
+    struct TimeManager tm;
+    timeman_start(&tm, SEARCH_NO_TIME_LIMIT_MS, SEARCH_NO_TIME_LIMIT_MS);
+
+    tptable_new_search();
+    memset(killer_moves, 0, sizeof(killer_moves));
+
+    total_stats_lock();
+    memset(&total_stats, 0, sizeof(total_stats));
+    total_stats_unlock();
+
+    // The same deepening loop as movegen_task, minus the deadline checks.
+    int prev_value = 0;
+    bool have_prev = false;
+
+    for (int depth = 1; depth <= max_depth && depth <= MAX_SEARCH_DEPTH; depth++) {
+        int delta = ASPIRATION_WINDOW;
+        int alpha = have_prev ? MAX(prev_value - delta, INT_MIN + 1) : INT_MIN + 1;
+        int beta = have_prev ? MIN(prev_value + delta, INT_MAX) : INT_MAX;
+
+        for (;;) {
+            int value = negamax_from_root(state, alpha, beta, depth, &tm, true, result_out);
+
+            // The timeout sentinel cannot occur (the deadlines never expire and nothing else
+            // sets the stop flag), but bail out rather than loop forever if that ever changes.
+            if (value == INT_MIN) return;
+
+            if (value <= alpha) {
+                delta *= ASPIRATION_WIDEN_FACTOR;
+                alpha = delta > ROUGH_MAX_POSITION_VALUE ? INT_MIN + 1 : value - delta;
+            } else if (value >= beta) {
+                delta *= ASPIRATION_WIDEN_FACTOR;
+                beta = delta > ROUGH_MAX_POSITION_VALUE ? INT_MAX : value + delta;
+            } else {
+                prev_value = value;
+                have_prev = true;
+                break;
+            }
+        }
+    }
+
+    thread_stats.elapsed_ms = timeman_elapsed_ms(&tm);
+    search_stats_flush();
+}
+
 // Checks if the game is stalemate.
 // The game is stalemate when the player to move has no possible legal moves, but is not in check.
 bool is_stalemate(struct GameState *state) {
@@ -659,11 +1622,12 @@ bool is_stalemate(struct GameState *state) {
     if (is_player_in_check(state, to_move)) return false;
 
     // If the king is not in check and there are no legal moves it is stalemate.
+    struct LegalityMasks masks = compute_legality_masks(state, to_move);
     struct BoardPos legal_moves[PIECE_LEGAL_MOVES_MAX];
     struct BoardPos *piece_list = to_move == WhitePlayer ? state->piece_list_white : state->piece_list_black;
     for (int i = 0; i < 16; i++) {
         if (!boardpos_eq(piece_list[i], NULL_BOARDPOS)) {
-            if (legal_moves_from_pos(state, piece_list[i], legal_moves) != 0) {
+            if (legal_moves_from_pos(state, piece_list[i], legal_moves, &masks) != 0) {
                 return false;
             }
         }
@@ -680,11 +1644,12 @@ bool is_player_checkmated(struct GameState *state, enum Player player) {
 
     // A player is checkmated if they are in check and have no legal moves to get themselves out of check.
     // All the player's pieces are checked to see if they have any legal moves.
+    struct LegalityMasks masks = compute_legality_masks(state, player);
     struct BoardPos legal_moves[PIECE_LEGAL_MOVES_MAX];
     struct BoardPos *piece_list = player == WhitePlayer ? state->piece_list_white : state->piece_list_black;
     for (int i = 0; i < 16; i++) {
         if (!boardpos_eq(piece_list[i], NULL_BOARDPOS)) {
-            if (legal_moves_from_pos(state, piece_list[i], legal_moves) != 0) {
+            if (legal_moves_from_pos(state, piece_list[i], legal_moves, &masks) != 0) {
                 return false;
             }
         }
@@ -703,10 +1668,46 @@ static bool is_state_legal(struct GameState *state) {
 
 // Makes a move, updating the board and other state such as castling rights and en passant targets.
 // If calculate_hash is true the Zobrist hash of the new state will be written to state->hash.
+// The hash is updated incrementally from the pre-move hash (XORing the moved, captured and castled
+// pieces plus the castling-right, en passant and side-to-move deltas) instead of rehashing the
+// whole state, as this function is called millions of times inside the search.
 void make_move(struct GameState *state, struct Move move, bool calculate_hash) {
     struct Piece from_piece = get_piece(state, move.from);
     struct Piece to_piece = get_piece(state, move.to);
 
+    // Record the pre-move hash in the history ring so repetitions can be detected, and reset the
+    // halfmove clock on irreversible moves: pawn moves (which covers en passant and promotions)
+    // and captures. No position from before an irreversible move can ever repeat, which is what
+    // bounds the repetition scan by the clock.
+    state->hash_history[state->move_count % HASH_HISTORY_MAX] = state->hash;
+    if (from_piece.type == Pawn || to_piece.type != Empty) {
+        state->halfmove_clock = 0;
+    } else {
+        state->halfmove_clock += 1;
+    }
+
+    // Start from the current hash with its en passant contribution removed; the new en passant
+    // contribution is XORed back in once the move has been applied. The en passant part depends on
+    // the surrounding board (see zobrist_enpassant_part) so it cannot be a simple per-move XOR.
+    ZobristHash hash = state->hash ^ zobrist_enpassant_part(state);
+
+    // Record the castling rights so that any rights removed by this move can be XORed out of the
+    // hash at the end.
+    bool prev_castlert[4] = {state->white_castlert_left, state->white_castlert_right, state->black_castlert_left,
+                             state->black_castlert_right};
+
+    // Remove castling rights if a rook is captured at its starting position. This must be checked
+    // independently of the moved piece below: the capturer can itself be a pawn (including a
+    // capture-promotion) or a rook leaving its own starting square, and both of those take other
+    // branches of the chain.
+    if (to_piece.type == Rook && (boardpos_eq(move.to, ROOK_STARTING_POSITIONS_LEFT[to_piece.player]) ||
+                                  boardpos_eq(move.to, ROOK_STARTING_POSITIONS_RIGHT[to_piece.player]))) {
+        if (move.to.file == 0)
+            unset_castlert_left(state, to_piece.player);
+        else if (move.to.file == 7)
+            unset_castlert_right(state, to_piece.player);
+    }
+
     if (from_piece.type == Pawn) {
         if ((abs(move.from.rank - move.to.rank) == 2)) {
             // Add en passant target files on double pawn push.
@@ -718,10 +1719,11 @@ void make_move(struct GameState *state, struct Move move, bool calculate_hash) {
         } else {
             if (move.from.file != move.to.file && to_piece.type == Empty) {
                 // Perform en passant capture.
-                put_piece(state, Piece(Empty, WhitePlayer), BoardPos(move.to.file, move.from.rank));
+                struct BoardPos captured_pos = BoardPos(move.to.file, move.from.rank);
+                hash = zobrist_toggle_piece(hash, get_piece(state, captured_pos), captured_pos);
+                put_piece(state, Piece(Empty, WhitePlayer), captured_pos);
                 // Remove en passant captured piece from piece list
-                change_piece_list_pos(state, other_player(from_piece.player), BoardPos(move.to.file, move.from.rank),
-                                      NULL_BOARDPOS);
+                change_piece_list_pos(state, other_player(from_piece.player), captured_pos, NULL_BOARDPOS);
             }
 
             // Remove en passant target if a pawn on the file does not double push.
@@ -734,13 +1736,6 @@ void make_move(struct GameState *state, struct Move move, bool calculate_hash) {
             unset_castlert_left(state, from_piece.player);
         else if (move.from.file == 7)
             unset_castlert_right(state, from_piece.player);
-    } else if (to_piece.type == Rook && (boardpos_eq(move.to, ROOK_STARTING_POSITIONS_LEFT[to_piece.player]) ||
-                                         boardpos_eq(move.to, ROOK_STARTING_POSITIONS_RIGHT[to_piece.player]))) {
-        // Remove castling rights if a rook is captured at its starting position.
-        if (move.to.file == 0)
-            unset_castlert_left(state, to_piece.player);
-        else if (move.to.file == 7)
-            unset_castlert_right(state, to_piece.player);
     } else if (from_piece.type == King) {
         // Remove all castling rights if the king moves.
         unset_castlert_left(state, from_piece.player);
@@ -749,10 +1744,14 @@ void make_move(struct GameState *state, struct Move move, bool calculate_hash) {
         // Move the rook if the move is castling.
         if (boardpos_eq(move.from, KING_STARTING_POSITIONS[from_piece.player])) {
             if (move.to.file == 2) {
+                hash = zobrist_toggle_piece(hash, Piece(Rook, from_piece.player), BoardPos(0, move.from.rank));
+                hash = zobrist_toggle_piece(hash, Piece(Rook, from_piece.player), BoardPos(3, move.from.rank));
                 move_piece(state, BoardPos(0, move.from.rank), BoardPos(3, move.from.rank));
                 change_piece_list_pos(state, from_piece.player, BoardPos(0, move.from.rank),
                                       BoardPos(3, move.from.rank));
             } else if (move.to.file == 6) {
+                hash = zobrist_toggle_piece(hash, Piece(Rook, from_piece.player), BoardPos(7, move.from.rank));
+                hash = zobrist_toggle_piece(hash, Piece(Rook, from_piece.player), BoardPos(5, move.from.rank));
                 put_piece(state, Piece(Empty, WhitePlayer), BoardPos(7, move.from.rank));
                 put_piece(state, Piece(Rook, from_piece.player), BoardPos(5, move.from.rank));
                 change_piece_list_pos(state, from_piece.player, BoardPos(7, move.from.rank),
@@ -779,6 +1778,14 @@ void make_move(struct GameState *state, struct Move move, bool calculate_hash) {
         new_piece = Piece(Queen, from_piece.player);
     }
 
+    // XOR the moved piece out of its old square and into its new square (as the promoted piece if
+    // the move was a promotion), and XOR out any captured piece.
+    hash = zobrist_toggle_piece(hash, from_piece, move.from);
+    hash = zobrist_toggle_piece(hash, new_piece, move.to);
+    if (to_piece.type != Empty) {
+        hash = zobrist_toggle_piece(hash, to_piece, move.to);
+    }
+
     // Move the piece.
     put_piece(state, new_piece, move.to);
     put_piece(state, Piece(Empty, WhitePlayer), move.from);
@@ -793,14 +1800,124 @@ void make_move(struct GameState *state, struct Move move, bool calculate_hash) {
     // A move has been made so the player to move swaps.
     state->white_to_move = !state->white_to_move;
 
-    // Calculate the Zobrist hash of the new state if needed.
+    // XOR out any castling rights which were removed by this move.
+    if (state->white_castlert_left != prev_castlert[0]) hash = zobrist_toggle_castlert(hash, WhitePlayer, true);
+    if (state->white_castlert_right != prev_castlert[1]) hash = zobrist_toggle_castlert(hash, WhitePlayer, false);
+    if (state->black_castlert_left != prev_castlert[2]) hash = zobrist_toggle_castlert(hash, BlackPlayer, true);
+    if (state->black_castlert_right != prev_castlert[3]) hash = zobrist_toggle_castlert(hash, BlackPlayer, false);
+
+    // The side to move key is XORed on every move, and the en passant contribution of the new
+    // state is XORed back in.
+    hash = zobrist_toggle_white_to_move(hash);
+    hash ^= zobrist_enpassant_part(state);
+
     if (calculate_hash) {
-        state->hash = hash_state(state);
+        state->hash = hash;
+
+        // Cross-check the incremental update against a full rehash in debug builds.
+        assert(state->hash == hash_state(state));
     } else {
         state->hash = 0;
     }
 }
 
+// Returns the index of `pos` in a player's piece list, or -1 if it is not present.
+static int8_t piece_list_index_of(struct GameState *state, enum Player player, struct BoardPos pos) {
+    struct BoardPos *piece_list = player == WhitePlayer ? state->piece_list_white : state->piece_list_black;
+    for (int8_t i = 0; i < 16; i++) {
+        if (boardpos_eq(piece_list[i], pos)) return i;
+    }
+    return -1;
+}
+
+// Makes a move like make_move, additionally filling `undo` with the information needed to reverse
+// the move with unmake_move.
+// This allows the search to make and unmake moves on a single GameState instead of allocating and
+// copying a new state at every node, which dominated the search time.
+void make_move_undoable(struct GameState *state, struct Move move, struct MoveUndo *undo, bool calculate_hash) {
+    struct Piece from_piece = get_piece(state, move.from);
+    struct Piece to_piece = get_piece(state, move.to);
+
+    undo->move = move;
+    undo->moved_piece = from_piece;
+    undo->captured_piece = to_piece;
+    undo->captured_pos = move.to;
+
+    // An en passant capture removes a pawn which is not on the `to` square.
+    if (from_piece.type == Pawn && move.from.file != move.to.file && to_piece.type == Empty) {
+        undo->captured_pos = BoardPos(move.to.file, move.from.rank);
+        undo->captured_piece = get_piece(state, undo->captured_pos);
+    }
+
+    // The piece list index must be recorded before make_move removes the captured piece from the
+    // list, as unmake_move cannot search the list for a removed (NULL_BOARDPOS) entry - captures
+    // may leave multiple NULL_BOARDPOS entries in the list.
+    undo->captured_list_idx = undo->captured_piece.type == Empty
+                                  ? -1
+                                  : piece_list_index_of(state, undo->captured_piece.player, undo->captured_pos);
+
+    undo->enpassant_target_white = state->enpassant_target_white;
+    undo->enpassant_target_black = state->enpassant_target_black;
+    undo->white_castlert_left = state->white_castlert_left;
+    undo->white_castlert_right = state->white_castlert_right;
+    undo->black_castlert_left = state->black_castlert_left;
+    undo->black_castlert_right = state->black_castlert_right;
+    undo->white_king = state->white_king;
+    undo->black_king = state->black_king;
+    undo->white_king_in_check = state->white_king_in_check;
+    undo->black_king_in_check = state->black_king_in_check;
+    undo->hash = state->hash;
+    undo->halfmove_clock = state->halfmove_clock;
+
+    make_move(state, move, calculate_hash);
+}
+
+// Reverses a move made with make_move_undoable, restoring the GameState to exactly the state it
+// was in before the move.
+void unmake_move(struct GameState *state, const struct MoveUndo *undo) {
+    struct Move move = undo->move;
+
+    // Put the moved piece back (this also reverses any promotion) and clear the destination.
+    put_piece(state, undo->moved_piece, move.from);
+    put_piece(state, Piece(Empty, WhitePlayer), move.to);
+    change_piece_list_pos(state, undo->moved_piece.player, move.to, move.from);
+
+    // Restore a captured piece. The capture square is not `to` for en passant captures.
+    if (undo->captured_piece.type != Empty) {
+        put_piece(state, undo->captured_piece, undo->captured_pos);
+        struct BoardPos *piece_list =
+            undo->captured_piece.player == WhitePlayer ? state->piece_list_white : state->piece_list_black;
+        piece_list[undo->captured_list_idx] = undo->captured_pos;
+    }
+
+    // Move the rook back if the move was castling.
+    if (undo->moved_piece.type == King && abs(move.from.file - move.to.file) == 2) {
+        struct BoardPos rook_home = BoardPos(move.to.file == 2 ? 0 : 7, move.from.rank);
+        struct BoardPos rook_castled = BoardPos(move.to.file == 2 ? 3 : 5, move.from.rank);
+        move_piece(state, rook_castled, rook_home);
+        change_piece_list_pos(state, undo->moved_piece.player, rook_castled, rook_home);
+    }
+
+    // Restore the remaining recorded state.
+    state->enpassant_target_white = undo->enpassant_target_white;
+    state->enpassant_target_black = undo->enpassant_target_black;
+    state->white_castlert_left = undo->white_castlert_left;
+    state->white_castlert_right = undo->white_castlert_right;
+    state->black_castlert_left = undo->black_castlert_left;
+    state->black_castlert_right = undo->black_castlert_right;
+    state->white_king = undo->white_king;
+    state->black_king = undo->black_king;
+    state->white_king_in_check = undo->white_king_in_check;
+    state->black_king_in_check = undo->black_king_in_check;
+    state->hash = undo->hash;
+    state->halfmove_clock = undo->halfmove_clock;
+
+    // The history ring needs no restore: the slot written by the move being unmade is indexed by
+    // the old move_count, and will simply be overwritten by the next move made at this ply.
+    state->move_count -= 1;
+    state->white_to_move = !state->white_to_move;
+}
+
 // Returns if it is possible for a piece to move from one position to another.
 // It does not check legality (e.g. if in check, castling rights), it only checks if a the move follows the patterns of
 // the piece.
@@ -817,7 +1934,7 @@ static bool is_move_possible(struct GameState *state, struct Move move) {
     switch (from_piece.type) {
         case King:
             // The king can normally move a maximum of one square in any direction.
-            if (abs(move.from.file - move.to.file) <= 1 && abs(move.from.rank - move.to.rank) <= 1) {
+            if (bb_king_attacks(bb_square(move.from)) & bb_from_pos(move.to)) {
                 return true;
             }
 
@@ -849,55 +1966,27 @@ static bool is_move_possible(struct GameState *state, struct Move move) {
             return false;
         case Queen:
         case Rook:
-        case Bishop:
-            if (move.from.file == move.to.file) {
-                // Vertical movement - only the queen and rook can move vertically.
-                if (from_piece.type == Bishop) return false;
-
-                // Make sure there are no pieces in the way of the move.
-                for (int i = MIN(move.from.rank, move.to.rank) + 1; i < MAX(move.from.rank, move.to.rank); i++) {
-                    struct Piece check = get_piece(state, BoardPos(move.from.file, i));
-                    if (check.type != Empty) return false;
-                }
-
-                return true;
-            } else if (move.from.rank == move.to.rank) {
-                // Horizontal movement - only the queen and rook can move horizontally.
-                if (from_piece.type == Bishop) return false;
-
-                // Make sure there are no pieces in the way of the move.
-                for (int i = MIN(move.from.file, move.to.file) + 1; i < MAX(move.from.file, move.to.file); i++) {
-                    struct Piece check = get_piece(state, BoardPos(i, move.from.rank));
-                    if (check.type != Empty) return false;
-                }
-
-                return true;
-            } else if (abs(move.from.file - move.to.file) == abs(move.from.rank - move.to.rank)) {
-                // Diagonal movement - only the queen and bishop can move diagonally.
-                if (from_piece.type == Rook) return false;
-
-                // Make sure there are no pieces in the way of the move.
-                int file_add = move.from.file > move.to.file ? -1 : 1;
-                int rank_add = move.from.rank > move.to.rank ? -1 : 1;
-                int file = move.from.file + file_add;
-                int rank = move.from.rank + rank_add;
-                while (file != move.to.file) {
-                    struct Piece check = get_piece(state, BoardPos(file, rank));
-                    if (check.type != Empty) return false;
-
-                    file += file_add;
-                    rank += rank_add;
-                }
-
-                return true;
+        case Bishop: {
+            // The attack maps give exactly the squares reachable along the piece's rays given the
+            // current occupancy, so no per-square stepping is needed.
+            Bitboard occupancy = state->bb_player[WhitePlayer] | state->bb_player[BlackPlayer];
+            int sq = bb_square(move.from);
+
+            Bitboard attacks;
+            if (from_piece.type == Rook) {
+                attacks = bb_rook_attacks(sq, occupancy);
+            } else if (from_piece.type == Bishop) {
+                attacks = bb_bishop_attacks(sq, occupancy);
+            } else {
+                attacks = bb_queen_attacks(sq, occupancy);
             }
 
-            return false;
+            return (attacks & bb_from_pos(move.to)) != 0;
+        }
         case Knight:
             // The knight must move in an 'L' shape.
             // A knight can move over the top of other pieces, so no need to check if there are pieces in the way.
-            return (abs(move.from.file - move.to.file) == 2 && abs(move.from.rank - move.to.rank) == 1) ||
-                   (abs(move.from.file - move.to.file) == 1 && abs(move.from.rank - move.to.rank) == 2);
+            return (bb_knight_attacks(bb_square(move.from)) & bb_from_pos(move.to)) != 0;
         case Pawn:;
             // A pawn can move one or two squares vertically in the direction towards the other player,
             // or one square diagonally in the direction towards the other player.
@@ -913,8 +2002,53 @@ static bool is_move_possible(struct GameState *state, struct Move move) {
     return false;
 }
 
-// Checks if a move is legal.
-bool is_move_legal(struct GameState *state, struct Move move) {
+// Computes the legality masks for `player` in the current position, from the king position and
+// the symmetric attack maps.
+static struct LegalityMasks compute_legality_masks(struct GameState *state, enum Player player) {
+    int king_sq = bb_square(player == WhitePlayer ? state->white_king : state->black_king);
+    Bitboard occupancy = state->bb_player[WhitePlayer] | state->bb_player[BlackPlayer];
+    Bitboard enemy = state->bb_player[other_player(player)];
+    Bitboard rook_like = enemy & (state->bb_type[Rook] | state->bb_type[Queen]);
+    Bitboard bishop_like = enemy & (state->bb_type[Bishop] | state->bb_type[Queen]);
+
+    // The enemy pieces currently giving check, found by intersecting the attack maps from the
+    // king square with the enemy pieces of each type (as in is_piece_attacked).
+    Bitboard checkers = (bb_knight_attacks(king_sq) & enemy & state->bb_type[Knight]) |
+                        (bb_pawn_attacks(king_sq, player) & enemy & state->bb_type[Pawn]) |
+                        (bb_rook_attacks(king_sq, occupancy) & rook_like) |
+                        (bb_bishop_attacks(king_sq, occupancy) & bishop_like);
+
+    struct LegalityMasks masks;
+    if (checkers == 0) {
+        masks.check_mask = ~(Bitboard)0;
+    } else if (bb_popcount(checkers) == 1) {
+        // A single check is resolved by capturing the checker or blocking its ray to the king.
+        masks.check_mask = checkers | bb_between(king_sq, bb_scan_forward(checkers));
+    } else {
+        // Double check: only a king move can resolve it.
+        masks.check_mask = 0;
+    }
+
+    // Absolute pins: enemy sliders which would attack the king on an empty board and have exactly
+    // one of the player's pieces between themselves and the king.
+    masks.pinned = 0;
+    Bitboard snipers = (bb_rook_attacks(king_sq, 0) & rook_like) | (bb_bishop_attacks(king_sq, 0) & bishop_like);
+    while (snipers) {
+        int sniper = bb_scan_forward(snipers);
+        snipers &= snipers - 1;
+
+        Bitboard blockers = bb_between(king_sq, sniper) & occupancy;
+        if (blockers && (blockers & (blockers - 1)) == 0 && (blockers & state->bb_player[player])) {
+            masks.pinned |= blockers;
+        }
+    }
+
+    return masks;
+}
+
+// Checks if a move is legal, given the legality masks for the position (which must have been
+// computed for the side to move).
+static bool is_move_legal_masked(struct GameState *state, struct Move move, const struct LegalityMasks *masks) {
     // First check if the move follows the move patterns of the piece being moved.
     if (!is_move_possible(state, move)) return false;
 
@@ -965,113 +2099,84 @@ bool is_move_legal(struct GameState *state, struct Move move) {
                 (move.to.file == 6 && !state->black_castlert_right))
                 return false;
         }
-    }
 
-    // Check if the resulting state after the move is legal, for example the player which has moved must not be in
-    // check.
-    struct GameState *state_copy = copy_gamestate(state);
-    make_move(state_copy, move, false);
-    bool legal = is_state_legal(state_copy);
-    free(state_copy);
+        // The rook must actually be on its starting square: a position loaded from FEN can claim
+        // rights without the rook, and castling without one would corrupt the board.
+        struct Piece rook = get_piece(state, BoardPos(move.to.file == 2 ? 0 : 7, move.from.rank));
+        if (rook.type != Rook || rook.player != from_piece.player) return false;
+    }
 
-    return legal;
-}
+    // En passant removes a second piece from the board (possibly discovering a check along the
+    // king's rank) and castling moves two pieces at once, so those rare cases keep the
+    // make/unmake legality test. Every other move is filtered against the precomputed check and
+    // pin masks without touching the state.
+    bool enpassant = from_piece.type == Pawn && move.from.file != move.to.file && to_piece.type == Empty;
+    bool castle = from_piece.type == King && abs(move.from.file - move.to.file) == 2;
+    if (enpassant || castle) {
+        struct MoveUndo undo;
+        make_move_undoable(state, move, &undo, false);
+        bool legal = is_state_legal(state);
+        unmake_move(state, &undo);
+        return legal;
+    }
 
-// Checks if a certain player's piece is being attacked, or if an empty square is controlled.
-bool is_piece_attacked(struct GameState *state, struct BoardPos attackee_pos, enum Player attacker) {
-    struct Piece attackee_piece = get_piece(state, attackee_pos);
-
-    // Each possible attacker piece type is checked, each piece moves differently.
-    // For each piece type every valid (regardless of legality) move pattern ending at the attackee position is checked
-    // to see if there is an attacking piece of that type in an attacking position.
-
-    // Check King, Rook, Bishop, Queen
-    for (int i = 0; i < 8; i++) {
-        const struct BoardPos translation = PIECE_MOVE_DIRECTIONS[Queen - 1][i];
-
-        const bool is_diagonal = abs(translation.file) == abs(translation.rank);
-        bool is_king = true;
-        
-        struct BoardPos check = boardpos_add(attackee_pos, translation);
-        while (!boardpos_eq(check, NULL_BOARDPOS)) {
-            struct Piece check_piece = get_piece(state, check);
-
-            if (check_piece.type != Empty) {
-                // Check if there is an attacking piece of the correct type in the possible attacking
-                // position.
-
-                bool correct_piece = check_piece.type == Queen || (is_king && check_piece.type == King) ||
-                                     (is_diagonal && check_piece.type == Bishop) ||
-                                     (!is_diagonal && check_piece.type == Rook);
-
-                if (correct_piece && check_piece.player == attacker) {
-                    return true;
-                } else {
-                    break;
-                }
-            }
+    if (from_piece.type == King) {
+        // The king may only move to a square the enemy does not attack. Its own bit is cleared
+        // from the occupancy first so sliders are not blocked by the square the king is leaving.
+        Bitboard king_bit = bb_from_pos(move.from);
+        state->bb_player[from_piece.player] ^= king_bit;
+        state->bb_type[King] ^= king_bit;
+        bool attacked = is_piece_attacked(state, move.to, other_player(from_piece.player));
+        state->bb_player[from_piece.player] ^= king_bit;
+        state->bb_type[King] ^= king_bit;
+        return !attacked;
+    }
 
-            // Kings can only move one square.
-            is_king = false;
+    // A non-king move must capture the checker or block the check. The mask is every square when
+    // the king is not in check, and empty in double check where only the king may move.
+    if (!(bb_from_pos(move.to) & masks->check_mask)) return false;
 
-            // Queens, rooks and bishops can attack over multiple squares in the same direction, so the
-            // check continues for every square in that direction. Overflow is handled by boardpos_add,
-            // NULL_BOARDPOS will be returned if the add overflows.
-            check = boardpos_add(check, translation);
-        }
+    // An absolutely pinned piece may only move along the line through itself and the king.
+    if (bb_from_pos(move.from) & masks->pinned) {
+        struct BoardPos king_pos = from_piece.player == WhitePlayer ? state->white_king : state->black_king;
+        if (!(bb_line(bb_square(king_pos), bb_square(move.from)) & bb_from_pos(move.to))) return false;
     }
 
-    // Check Pawn
-    for (int i = 0; i < 8; i++) {
-        // The pawn has less than eight possible move directions, so a NULL_BOARDPOS singifies
-        // we have reached the end of all the possible directions.
-        if (boardpos_eq(PIECE_MOVE_DIRECTIONS[Pawn - 1][i], NULL_BOARDPOS)) {
-            break;
-        }
+    return true;
+}
 
-        struct BoardPos direction = PIECE_MOVE_DIRECTIONS[Pawn - 1][i];
+// Checks if a move is legal.
+// Computes the legality masks for just this one move; the move generators instead compute them
+// once per node and go through is_move_legal_masked directly.
+bool is_move_legal(struct GameState *state, struct Move move) {
+    struct LegalityMasks masks = compute_legality_masks(state, state->white_to_move ? WhitePlayer : BlackPlayer);
+    return is_move_legal_masked(state, move, &masks);
+}
 
-        // The pawn only attacks on the two diagonal squares in front of it, so ignore moves which remain in
-        // the same file.
-        if (direction.file == 0) continue;
+// Checks if a certain player's piece is being attacked, or if an empty square is controlled.
+bool is_piece_attacked(struct GameState *state, struct BoardPos attackee_pos, enum Player attacker) {
+    int sq = bb_square(attackee_pos);
+    Bitboard occupancy = state->bb_player[WhitePlayer] | state->bb_player[BlackPlayer];
+    Bitboard attacker_pieces = state->bb_player[attacker];
 
-        // If it is black attacking the pawns move in the opposite direction.
-        if (attackee_piece.player == BlackPlayer) {
-            direction.file *= -1;
-            direction.rank *= -1;
-        }
+    // For each piece type the attack map from the attackee square is intersected with the
+    // attacker's pieces of that type - attacks are symmetric, so a piece standing on the attackee
+    // square would attack exactly the squares it can be attacked from.
 
-        struct BoardPos check = boardpos_add(attackee_pos, direction);
-        if (!boardpos_eq(check, NULL_BOARDPOS)) {
-            // Check if there is an attacking piece of the correct type in the possible attacking
-            // position.
-            struct Piece check_piece = get_piece(state, check);
-            if (check_piece.type == Pawn && check_piece.player == attacker) {
-                return true;
-            }
-        }
-    }
+    // Knights and kings: one table lookup each.
+    if (bb_knight_attacks(sq) & attacker_pieces & state->bb_type[Knight]) return true;
+    if (bb_king_attacks(sq) & attacker_pieces & state->bb_type[King]) return true;
 
-    // Check Knight
-    for (int i = 0; i < 8; i++) {
-        // The knight has less than eight possible move directions, so a NULL_BOARDPOS singifies
-        // we have reached the end of all the possible directions.
-        if (boardpos_eq(PIECE_MOVE_DIRECTIONS[Knight - 1][i], NULL_BOARDPOS)) {
-            break;
-        }
+    // Sliding pieces: the ray attacks from the attackee square given the current occupancy.
+    Bitboard rook_like = attacker_pieces & (state->bb_type[Rook] | state->bb_type[Queen]);
+    if (rook_like && (bb_rook_attacks(sq, occupancy) & rook_like)) return true;
 
-        struct BoardPos direction = PIECE_MOVE_DIRECTIONS[Knight - 1][i];
-        struct BoardPos check = boardpos_add(attackee_pos, direction);
+    Bitboard bishop_like = attacker_pieces & (state->bb_type[Bishop] | state->bb_type[Queen]);
+    if (bishop_like && (bb_bishop_attacks(sq, occupancy) & bishop_like)) return true;
 
-        if (!boardpos_eq(check, NULL_BOARDPOS)) {
-            // Check if there is an attacking piece of the correct type in the possible attacking
-            // position.
-            struct Piece check_piece = get_piece(state, check);
-            if (check_piece.type == Knight && check_piece.player == attacker) {
-                return true;
-            }
-        }
-    }
+    // Pawns attack asymmetrically: the squares an attacking pawn can attack this square from are
+    // the squares a pawn of the *other* player standing on this square would attack.
+    if (bb_pawn_attacks(sq, other_player(attacker)) & attacker_pieces & state->bb_type[Pawn]) return true;
 
     return false;
 }
@@ -2,6 +2,7 @@
 #include <ctype.h>
 #include <engine.h>
 #include <fen.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <zobrist.h>
 
@@ -104,7 +105,8 @@ struct GameState *fen_to_gamestate(const char *fen) {
                 goto exit_error;
             }
 
-            out->board[file++][rank] = piece;
+            // put_piece keeps the occupancy bitboards in sync with the board array.
+            put_piece(out, piece, BoardPos(file++, rank));
 
             if (piece.type == King) {
                 // Cannot have multiple kings
@@ -258,8 +260,27 @@ struct GameState *fen_to_gamestate(const char *fen) {
         goto exit_error;
     }
 
-    // The halfmove clock and fullmove number would usually follow,
-    // but they are not used in this game so are ignored.
+    // Parse the halfmove clock: the number of halfmoves since the last capture or pawn move,
+    // used for the fifty-move rule and to bound repetition scans
+    out->halfmove_clock = 0;
+    while (fen[i] >= '0' && fen[i] <= '9') {
+        out->halfmove_clock = out->halfmove_clock * 10 + (fen[i++] - '0');
+    }
+
+    // Parse the fullmove number, which starts at 1 and increments after each of black's moves.
+    // It is converted into the ply count stored in move_count.
+    if (fen[i] == ' ') {
+        i += 1;
+
+        int fullmove = 0;
+        while (fen[i] >= '0' && fen[i] <= '9') {
+            fullmove = fullmove * 10 + (fen[i++] - '0');
+        }
+
+        if (fullmove > 0) {
+            out->move_count = (fullmove - 1) * 2 + (out->white_to_move ? 0 : 1);
+        }
+    }
 
     // Check that there are two kings on the board
     if (boardpos_eq(out->white_king, NULL_BOARDPOS) || boardpos_eq(out->black_king, NULL_BOARDPOS)) {
@@ -367,12 +388,7 @@ void gamestate_to_fen(struct GameState *state, char *fen) {
     // A space separates the sections
     fen[i++] = ' ';
 
-    // The halfmove clock and fullmove number are not used
-    // in this game, so are both set to zero
-    fen[i++] = '0';
-    fen[i++] = ' ';
-    fen[i++] = '0';
-
-    // Add NUL terminator
-    fen[i++] = '\0';
+    // Add the halfmove clock and the fullmove number, reversing the
+    // conversion done when parsing. This also writes the NUL terminator.
+    sprintf(&fen[i], "%d %d", state->halfmove_clock, state->move_count / 2 + 1);
 }
\ No newline at end of file
@@ -18,7 +18,9 @@ struct FrontendState frontend_state = {.game_state = NULL,
                                        .debug_allow_illegal_moves = false,
                                        .debug_copy_on_move = false,
                                        .threadpool = NULL,
-                                       .movegen_started = 0};
+                                       .movegen_running = false,
+                                       .ponder_running = false,
+                                       .ponder_hit = false};
 
 // Resets the parts of the frontend state used to store
 // data about the current game to the default values.
@@ -40,7 +42,15 @@ static void reset_ingame_frontend_state() {
     frontend_state.move_log_idx = 0;
     frontend_state.move_log_line_chars = 0;
     frontend_state.winner = WINNER_NONE;
-    frontend_state.movegen_started = 0;
+    frontend_state.movegen_running = false;
+
+    // Abort any ponder search left over from the previous game.
+    if (frontend_state.ponder_running || frontend_state.ponder_hit) {
+        timeman_stop(&frontend_state.ponder_timeman);
+    }
+    frontend_state.ponder_running = false;
+    frontend_state.ponder_hit = false;
+
     tptable_clear();
 }
 
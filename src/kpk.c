@@ -0,0 +1,162 @@
+// A king-and-pawn versus king (KPK) bitbase: one bit per position stating whether the side with
+// the pawn wins with best play. The evaluation probes it when the material reduces to KPK (see
+// position_value), replacing a search of 20+ plies to promotion with a table load that is exact.
+//
+// The table is generated once at startup by retrograde analysis, the same way the other lookup
+// tables are built in bitboard_init: every position is first classified by its immediate rules
+// (illegal, promotion in hand, stalemate, free pawn capture) and the remaining positions are
+// then swept repeatedly, a position resolving once its successors have - a win for the side to
+// move if any successor is won for it, a loss once every successor is. The sweep reaches a
+// fixpoint in a few dozen passes over the 196608 positions, well under the startup time of the
+// rest of the engine. Positions never resolved by the fixpoint are repetition-bound and
+// therefore draws, which is what the cleared bit already encodes.
+//
+// Positions are indexed in white-is-the-strong-side orientation with the pawn mirrored onto
+// files a-d, which kpk_probe applies transparently; callers with a black pawn flip the ranks and
+// the side to move (see the probe in position_value).
+
+#include <bitboard.h>
+#include <chess.h>
+#include <kpk.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util.h>
+
+// Results are bit flags so a position can combine the results of all its successor positions
+// with a single OR (see kpk_classify). An invalid position (overlapping pieces, adjacent kings,
+// or the side not to move left in check) contributes nothing to the OR.
+enum KPKResult { KPKInvalid = 0, KPKUnknown = 1, KPKDraw = 2, KPKWin = 4 };
+
+// 24 pawn squares (files a-d, ranks 2-7) * two king squares * side to move.
+#define KPK_POSITIONS (24 * 64 * 64 * 2)
+
+// The finished bitbase: bit set means white wins. ~24KB.
+static uint64_t KPK_BITBASE[KPK_POSITIONS / 64];
+
+// Packs a position into its table index. The pawn square must already be on files 0-3.
+static int kpk_index(bool white_to_move, int wk, int bk, int psq) {
+    int pawn_cell = psq % 8 + 4 * (psq / 8 - 1);
+    return (white_to_move ? 0 : 1) + 2 * (bk + 64 * (wk + 64 * pawn_cell));
+}
+
+// Chebyshev distance between two square indices: the number of king moves between them.
+static int kpk_distance(int a, int b) { return MAX(abs(a % 8 - b % 8), abs(a / 8 - b / 8)); }
+
+// Classifies a position by the immediate rules alone, before any successors are known.
+// White pawns advance towards rank 0 (see chess.h), so the promotion square is psq - 8.
+static enum KPKResult kpk_classify_leaf(bool white_to_move, int wk, int bk, int psq) {
+    if (wk == bk || wk == psq || bk == psq || (bb_king_attacks(wk) & bb_from_square(bk)) != 0 ||
+        (white_to_move && (bb_pawn_attacks(psq, WhitePlayer) & bb_from_square(bk)) != 0))
+        return KPKInvalid;
+
+    if (white_to_move) {
+        // The pawn promotes and the new queen cannot be captured: an immediate win. All wins in
+        // KPK propagate back from this base case.
+        int promote = psq - 8;
+        if (psq / 8 == 1 && wk != promote && (kpk_distance(bk, promote) > 1 || kpk_distance(wk, promote) == 1))
+            return KPKWin;
+    } else {
+        // Stalemate (the bare king has no square the white king or pawn does not cover), or the
+        // pawn is undefended and the king takes it: an immediate draw.
+        Bitboard covered = bb_king_attacks(wk) | bb_pawn_attacks(psq, WhitePlayer);
+        if ((bb_king_attacks(bk) & ~covered) == 0 ||
+            (bb_king_attacks(bk) & bb_from_square(psq) & ~bb_king_attacks(wk)) != 0)
+            return KPKDraw;
+    }
+
+    return KPKUnknown;
+}
+
+// Re-classifies an unknown position from the current results of its successors: the side to move
+// takes its best outcome, so the position is resolved as soon as one successor is good for it,
+// or once no successor is still unknown. Successors that are invalid positions (a king stepping
+// next to the other king, a push into a king) contribute nothing.
+static enum KPKResult kpk_classify(const uint8_t *db, bool white_to_move, int wk, int bk, int psq) {
+    enum KPKResult good = white_to_move ? KPKWin : KPKDraw;
+
+    int r = KPKInvalid;
+    for (Bitboard moves = bb_king_attacks(white_to_move ? wk : bk); moves != 0; moves &= moves - 1) {
+        int to = bb_scan_forward(moves);
+        r |= db[white_to_move ? kpk_index(false, to, bk, psq) : kpk_index(true, wk, to, psq)];
+    }
+
+    if (white_to_move) {
+        // Pawn pushes. A promoting push is already handled as a base case in kpk_classify_leaf,
+        // and a double push may not jump over or land on a king.
+        if (psq / 8 > 1) r |= db[kpk_index(false, wk, bk, psq - 8)];
+        if (psq / 8 == 6 && psq - 8 != wk && psq - 8 != bk && psq - 16 != wk && psq - 16 != bk)
+            r |= db[kpk_index(false, wk, bk, psq - 16)];
+    }
+
+    if (r & good) return good;
+    if (r & KPKUnknown) return KPKUnknown;
+    return white_to_move ? KPKDraw : KPKWin;
+}
+
+// Generates the bitbase. Must be called once at startup (alongside bitboard_init, which must
+// come first as the classification uses the king and pawn attack tables).
+void kpk_init() {
+    uint8_t *db = malloc(KPK_POSITIONS);
+    if (db == NULL) {
+        puts("error allocating kpk bitbase");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int idx = 0; idx < KPK_POSITIONS; idx++) {
+        bool white_to_move = (idx & 1) == 0;
+        int bk = (idx >> 1) % 64;
+        int wk = (idx >> 7) % 64;
+        int pawn_cell = idx >> 13;
+        int psq = (pawn_cell / 4 + 1) * 8 + pawn_cell % 4;
+        db[idx] = (uint8_t)kpk_classify_leaf(white_to_move, wk, bk, psq);
+    }
+
+    // Sweep until a fixpoint: each pass resolves the unknown positions whose successors settled
+    // in earlier passes, so resolved results flow backwards from the base cases.
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int idx = 0; idx < KPK_POSITIONS; idx++) {
+            if (db[idx] != KPKUnknown) continue;
+
+            bool white_to_move = (idx & 1) == 0;
+            int bk = (idx >> 1) % 64;
+            int wk = (idx >> 7) % 64;
+            int pawn_cell = idx >> 13;
+            int psq = (pawn_cell / 4 + 1) * 8 + pawn_cell % 4;
+
+            enum KPKResult r = kpk_classify(db, white_to_move, wk, bk, psq);
+            if (r != KPKUnknown) {
+                db[idx] = (uint8_t)r;
+                changed = true;
+            }
+        }
+    }
+
+    memset(KPK_BITBASE, 0, sizeof(KPK_BITBASE));
+    for (int idx = 0; idx < KPK_POSITIONS; idx++) {
+        if (db[idx] == KPKWin) KPK_BITBASE[idx / 64] |= UINT64_C(1) << (idx % 64);
+    }
+
+    free(db);
+}
+
+// Returns whether white wins the KPK position with best play, false meaning a draw. The position
+// is given in white-is-the-strong-side orientation (the pawn is white's); a caller whose pawn is
+// black mirrors the ranks and the side to move first. The position must be legal.
+bool kpk_probe(struct BoardPos white_king, struct BoardPos black_king, struct BoardPos pawn, bool white_to_move) {
+    int wk = bb_square(white_king);
+    int bk = bb_square(black_king);
+    int psq = bb_square(pawn);
+
+    // Mirror the files so the pawn is on files a-d, halving the table.
+    if (pawn.file > 3) {
+        wk ^= 7;
+        bk ^= 7;
+        psq ^= 7;
+    }
+
+    int idx = kpk_index(white_to_move, wk, bk, psq);
+    return (KPK_BITBASE[idx / 64] >> (idx % 64)) & 1;
+}
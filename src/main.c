@@ -1,12 +1,14 @@
 #ifdef CHESS_TEST
 #include "tests/test_main.c"
 #endif
+#include <bitboard.h>
 #include <config.h>
 #include <draw.h>
 #include <engine.h>
 #include <fen.h>
 #include <frontend_state.h>
 #include <inttypes.h>
+#include <kpk.h>
 #include <limits.h>
 #include <openings.h>
 #include <raygui.h>
@@ -21,6 +23,31 @@
 #include <ui.h>
 #include <zobrist.h>
 
+// Starts a ponder search: the predicted human reply is taken from the transposition table entry
+// of the current position (which the search that just finished filled in), and the position
+// after that reply is searched speculatively with an effectively unlimited budget while the
+// human thinks. If they play the predicted move the search is promoted to the real one with the
+// transposition table already hot (see the ponder resolution in game_loop); otherwise it is
+// aborted. Does nothing when no reply is predicted.
+static void start_ponder() {
+    struct TranspositionEntry entry = tptable_get(frontend_state.game_state->hash);
+    if (boardpos_eq(entry.best_move.from, NULL_BOARDPOS) ||
+        !is_move_legal(frontend_state.game_state, entry.best_move)) {
+        return;
+    }
+
+    // The search copies the position internally, so the predicted position is only needed until
+    // generate_move_timed returns.
+    struct GameState *predicted = copy_gamestate(frontend_state.game_state);
+    make_move(predicted, entry.best_move, true);
+
+    frontend_state.ponder_move = entry.best_move;
+    frontend_state.ponder_running = true;
+    generate_move_timed(predicted, frontend_state.threadpool, &frontend_state.ponder_timeman,
+                        MOVEGEN_PONDER_TIME_MS, MOVEGEN_PONDER_TIME_MS, NULL);
+    deinit_gamestate(predicted);
+}
+
 // Handles input and draws the chess board
 // To be called every frame
 // Must be called within BeginDrawing/EndDrawing
@@ -53,6 +80,11 @@ static void game_loop() {
         frontend_state.two_player_mode = !frontend_state.two_player_mode;
     }
 
+    // Toggle the search statistics overlay
+    if (IsKeyPressed(KEY_S)) {
+        frontend_state.debug_show_search_stats = !frontend_state.debug_show_search_stats;
+    }
+
     // Print the position value relative to white
     if (IsKeyPressed(KEY_V)) {
         printf("v: %d\n", position_value(frontend_state.game_state));
@@ -75,27 +107,36 @@ static void game_loop() {
     // Computer moves
     if (frontend_state.winner == WINNER_NONE && !frontend_state.two_player_mode &&
         !frontend_state.game_state->white_to_move) {
-        struct TranspositionEntry entry = tptable_get(frontend_state.game_state->hash);
+        // The search publishes its result to the completion mailbox, so reading it is two atomic
+        // loads instead of a transposition table probe every frame.
+        struct SearchResult result;
+        bool have_result = search_result_get(frontend_state.game_state->hash, &result);
+
+        // On a ponder hit the promoted ponder search is the real search, so its time manager is
+        // the one to poll for completion.
+        struct TimeManager *movegen_tm =
+            frontend_state.ponder_hit ? &frontend_state.ponder_timeman : &frontend_state.movegen_timeman;
 
-        if (frontend_state.movegen_started == 0) {
+        if (!frontend_state.movegen_running) {
             // Start generating moves if it wasn't started alrady.
-            frontend_state.movegen_started = time(NULL);
-            generate_move(frontend_state.game_state, frontend_state.threadpool, frontend_state.movegen_started);
-        } else if (entry.depth == CHAR_MAX || time(NULL) - frontend_state.movegen_started >= MAX_MOVEGEN_SEARCH_TIME) {
-            // Movegen has completed, make the move.
+            frontend_state.movegen_running = true;
+            generate_move(frontend_state.game_state, frontend_state.threadpool, &frontend_state.movegen_timeman);
+        } else if (timeman_stopped(movegen_tm)) {
+            // Movegen has completed (the search sets the stop flag when it finishes), make the move.
 
-            frontend_state.movegen_started = 0;
-            printf("[movegen] DONE %d %d\n", entry.depth, entry.value);
+            frontend_state.movegen_running = false;
+            frontend_state.ponder_hit = false;
+            printf("[movegen] DONE %d %d\n", have_result ? result.depth : 0, have_result ? result.value : 0);
 
-            if (!boardpos_eq(entry.best_move.from, NULL_BOARDPOS)) {
+            if (have_result) {
                 // Log and make the move.
-                log_move(entry.best_move.from, entry.best_move.to);
-                make_move(frontend_state.game_state, entry.best_move, true);
+                log_move(result.best_move.from, result.best_move.to);
+                make_move(frontend_state.game_state, result.best_move, true);
 
                 // Remove the selected piece if the piece no longer exists.
                 if (!boardpos_eq(frontend_state.selected_position, NULL_BOARDPOS) &&
                     (get_piece(frontend_state.game_state, frontend_state.selected_position).type == Empty ||
-                     boardpos_eq(frontend_state.selected_position, entry.best_move.to))) {
+                     boardpos_eq(frontend_state.selected_position, result.best_move.to))) {
                     frontend_state.selected_position = NULL_BOARDPOS;
                 }
 
@@ -105,6 +146,11 @@ static void game_loop() {
                 } else if (is_stalemate(frontend_state.game_state)) {
                     frontend_state.winner = WINNER_DRAW;
                 }
+
+                // The engine has moved; search the predicted reply while the human thinks.
+                if (frontend_state.winner == WINNER_NONE) {
+                    start_ponder();
+                }
             }
         }
     }
@@ -132,10 +178,28 @@ static void game_loop() {
                     // Make the move
                     make_move(frontend_state.game_state, (struct Move){frontend_state.selected_position, pos}, true);
 
+                    // Resolve a running ponder search against the move which was just played: if
+                    // the prediction was right the search is promoted to the real search - its
+                    // budget shrinks from effectively unlimited to the normal per-move budget,
+                    // counted from now - and if not it is aborted.
+                    if (frontend_state.ponder_running) {
+                        frontend_state.ponder_running = false;
+                        if (boardpos_eq(frontend_state.selected_position, frontend_state.ponder_move.from) &&
+                            boardpos_eq(pos, frontend_state.ponder_move.to)) {
+                            timeman_rearm(&frontend_state.ponder_timeman, MOVEGEN_SOFT_TIME_MS, MOVEGEN_HARD_TIME_MS);
+                            frontend_state.ponder_hit = true;
+                            frontend_state.movegen_running = true;
+                        } else {
+                            timeman_stop(&frontend_state.ponder_timeman);
+                        }
+                    }
+
                     // BUG: doesnt add to piece list
                     if (frontend_state.debug_copy_on_move) {
                         put_piece(frontend_state.game_state, get_piece(frontend_state.game_state, pos),
                                   frontend_state.selected_position);
+                        // put_piece does not touch the hash, so the cached board must be told.
+                        invalidate_board_cache();
                     }
 
                     frontend_state.selected_position = NULL_BOARDPOS;
@@ -152,15 +216,16 @@ static void game_loop() {
 
     draw_board(frontend_state.game_state);
 
-    // Draw a line on where the computer is thinking of moving
-    struct TranspositionEntry entry = tptable_get(frontend_state.game_state->hash);
+    // Draw a line on where the computer is thinking of moving, from the best move published so
+    // far by the running search.
+    struct SearchResult thinking;
     if (!frontend_state.two_player_mode && !frontend_state.game_state->white_to_move &&
-        !boardpos_eq(entry.best_move.from, NULL_BOARDPOS)) {
-        int x = entry.best_move.from.file * BOARD_SQUARE_SIZE + BOARD_SQUARE_SIZE / 2;
-        int y = entry.best_move.from.rank * BOARD_SQUARE_SIZE + BOARD_SQUARE_SIZE / 2;
+        search_result_get(frontend_state.game_state->hash, &thinking)) {
+        int x = thinking.best_move.from.file * BOARD_SQUARE_SIZE + BOARD_SQUARE_SIZE / 2;
+        int y = thinking.best_move.from.rank * BOARD_SQUARE_SIZE + BOARD_SQUARE_SIZE / 2;
 
-        int x2 = entry.best_move.to.file * BOARD_SQUARE_SIZE + BOARD_SQUARE_SIZE / 2;
-        int y2 = entry.best_move.to.rank * BOARD_SQUARE_SIZE + BOARD_SQUARE_SIZE / 2;
+        int x2 = thinking.best_move.to.file * BOARD_SQUARE_SIZE + BOARD_SQUARE_SIZE / 2;
+        int y2 = thinking.best_move.to.rank * BOARD_SQUARE_SIZE + BOARD_SQUARE_SIZE / 2;
 
         DrawLineEx((Vector2){x, y}, (Vector2){x2, y2}, 1.5f, Fade(RED, 0.8f));
     }
@@ -187,15 +252,26 @@ int main() {
 
     // Initialise the window
     InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "chess");
-    SetTargetFPS(15);
+    // 60 FPS is affordable now that the board renders from a cached texture (see draw_board);
+    // the low cap previously hiding the per-frame redraw cost made dragging feel sluggish.
+    SetTargetFPS(60);
     SetWindowMinSize(WINDOW_WIDTH, WINDOW_HEIGHT);
     GuiSetStyle(DEFAULT, TEXT_SIZE, 16);
 
     // Load required assets and create a new game
     load_textures();
     init_opening_book();
+    bitboard_init();
+    kpk_init();
     frontend_new_game();
-    tptable_init();
+    tptable_init(TPTABLE_DEFAULT_MB);
+
+    // With CHESS_TT_FILE set the transposition table persists across sessions (loaded here,
+    // saved back on exit), turning repeated analysis of the same lines into cache hits.
+    const char *tt_file = getenv("CHESS_TT_FILE");
+    if (tt_file != NULL && tptable_load(tt_file)) {
+        printf("loaded transposition table from %s\n", tt_file);
+    }
 
     while (!WindowShouldClose()) {
         BeginDrawing();
@@ -210,12 +286,26 @@ int main() {
         deinit_gamestate(frontend_state.game_state);
     }
 
+    // Abort any search still running (a ponder search can have minutes of budget left), so the
+    // pool threads finish their tasks and the pool can be shut down promptly.
+    if (frontend_state.ponder_running || frontend_state.ponder_hit) {
+        timeman_stop(&frontend_state.ponder_timeman);
+    }
+    if (frontend_state.movegen_running) {
+        timeman_stop(&frontend_state.movegen_timeman);
+    }
+
     if (frontend_state.threadpool != NULL) {
         threadpool_deinit(frontend_state.threadpool);
     }
 
     free(frontend_state.move_log);
 
+    // Persist the analysis of this session, now that no search can be writing the table.
+    if (tt_file != NULL && !tptable_save(tt_file)) {
+        printf("cannot save transposition table to %s\n", tt_file);
+    }
+
     deinit_opening_book();
     unload_textures();
     tptable_deinit();
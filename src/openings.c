@@ -1,49 +1,42 @@
-#include <assert.h>
+// The POSIX feature test macro is required for mmap.
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <openings.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-// Stores the moves in the opening list.
-// Implemented as a dynamically allocated array as the number of opening moves in the book is unknown,
-// so using a hash table would be difficult and there would be a chance of collisions.
-// The items list is binary searched, since the list is sorted by hash. Binary search has
-// an O(log n) worst case time complexity which is more than efficient enough for the expected number
-// of items (< 1 million).
-static struct OpeningItem *items = NULL;
-static const unsigned int ITEMS_MAX = INT32_MAX;
-static unsigned int items_count = 0;
-
-// Binary search the opening items, returns NULL if the item is not found.
-// High must be < items_count.
-static struct OpeningItem *binary_search_items(uint64_t hash, unsigned int low, unsigned int high) {
-    // Ensure overflow is not possible in debug builds.
-    assert(high < items_count);
-    assert(2 * (unsigned int)ITEMS_MAX - 2 <= UINT32_MAX);
-
-    while (low <= high) {
-        // SAFETY: high and low must be less than (2^31 - 1) as ITEMS_MAX is INT32_MAX (2^31 - 1).
-        // So (high + low) will be at most (2^32 - 4) which is within the range of an unsigned integer.
-        unsigned int mid = (high + low) / 2;
-        if (items[mid].hash == hash) {
-            return &items[mid];
-        } else if (items[mid].hash < hash) {
-            low = mid + 1;
-        } else {
-            high = mid - 1;
-        }
-    }
-
-    return NULL;
-}
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-// Finds a OpeningItem by hash, returns NULL if the hash is not found
-// The OpeningItem returned will be deallocated if deinit_opening_book is called
-struct OpeningItem *find_opening_by_hash(uint64_t hash) {
-    if (items_count == 0)
-        return NULL;
-    else
-        return binary_search_items(hash, 0, items_count - 1);
-}
+// The book is in Polyglot BIN format: http://hgm.nubati.net/book_format.html
+// The file is a flat array of 16 byte big-endian records sorted by position hash, so rather than
+// parsing it into a dynamic array up front the file is memory mapped and binary searched in
+// place, with the records for a hash decoded on demand by find_opening_by_hash. Startup does no
+// parsing at all and the operating system pages the book in as it is probed, so even a
+// multi-hundred-megabyte master book costs nothing until (and unless) it is used.
+
+// The size of one record in the book, in bytes.
+#define ENTRY_SIZE 16
+
+// The mapped book file and the number of records it holds.
+static const unsigned char *book = NULL;
+static size_t book_count = 0;
+
+#ifdef _WIN32
+static HANDLE book_file = INVALID_HANDLE_VALUE;
+static HANDLE book_mapping = NULL;
+#else
+static size_t book_size = 0;
+#endif
 
 // Converts a big endian u64 to the host byte order
 // These functions are reimplemented as they are not standard functions
@@ -60,13 +53,17 @@ static uint16_t ntohs(uint16_t n) {
     return ((uint16_t)np[0] << 8) | (uint16_t)np[1];
 }
 
-// Initialise the opening book from the opening book file.
-// Allocated memory must be deallocated using deinit_opening_book().
-// The book is in Polyglot BIN format: http://hgm.nubati.net/book_format.html
-void init_opening_book() {
-    // The size of the structure used to represent an opening in the book, in bytes.
-    const size_t ENTRY_SIZE = 16;
+// Reads the position hash of the `index`th record in the mapped book.
+static uint64_t record_hash(size_t index) {
+    // memcpy rather than a pointer cast: the mapping carries no alignment guarantees.
+    uint64_t hash;
+    memcpy(&hash, book + index * ENTRY_SIZE, sizeof(hash));
+    return ntohll(hash);
+}
 
+// Decodes the move of the `index`th record in the mapped book.
+// Returns false for moves the engine does not support (promotions to pieces other than a queen).
+static bool record_move(size_t index, struct Move *move_out) {
     // Each value in the move bit field is 3 bits wide.
     const uint16_t MOVE_VALUE_MASK = 0x7;
 
@@ -83,87 +80,138 @@ void init_opening_book() {
     const int PROMO_PIECE_NONE = 0;
     const int PROMO_PIECE_QUEEN = 4;
 
-    size_t items_size = 100;
-    items = malloc(sizeof(struct OpeningItem) * items_size);
+    // The move is the 2 bytes following the 8 byte hash.
+    uint16_t move;
+    memcpy(&move, book + index * ENTRY_SIZE + 8, sizeof(move));
+    move = ntohs(move);
 
-    FILE *book_file = fopen("res/opening_book.bin", "rb");
-    if (!book_file) {
-        perror("error initialising opening book");
-        exit(EXIT_FAILURE);
+    int to_file = (move >> TO_FILE_SHIFT) & MOVE_VALUE_MASK;
+    int to_row = (move >> TO_ROW_SHIFT) & MOVE_VALUE_MASK;
+    int from_file = (move >> FROM_FILE_SHIFT) & MOVE_VALUE_MASK;
+    int from_row = (move >> FROM_ROW_SHIFT) & MOVE_VALUE_MASK;
+    int promo_piece = (move >> PROMO_PIECE_SHIFT) & MOVE_VALUE_MASK;
+
+    // Promoting to pieces other than queen is unsupported.
+    if (promo_piece != PROMO_PIECE_NONE && promo_piece != PROMO_PIECE_QUEEN) {
+        return false;
     }
 
-    char entry[16];
-    while (fread(entry, ENTRY_SIZE, 1, book_file) == 1) {
-        // Stop reading new items if the maximum number was reached.
-        if (items_count == ITEMS_MAX) {
-            break;
-        }
+    // Row 0 is the bottom in the Polyglot BIN format (backwards compared to the scheme used for BoardPos).
+    *move_out = (struct Move){BoardPos(from_file, 7 - from_row), BoardPos(to_file, 7 - to_row)};
+    return true;
+}
 
-        // Extend the dynamic array if it is full.
-        if (items_count == items_size) {
-            items = realloc(items, sizeof(struct OpeningItem) * items_size * 2);
-            items_size *= 2;
+// Finds the book moves for a hash, decoding the run of records into `*item_out`. Returns false
+// if the hash is not in the book (or every record for it is an unsupported promotion). The moves
+// land in the caller's buffer and the mapped book is only read, so the book can be probed from
+// any number of threads concurrently (the self-play harness probes it from every game worker).
+bool find_opening_by_hash(uint64_t hash, struct OpeningItem *item_out) {
+    if (book_count == 0) return false;
+
+    // Lower-bound binary search for the first record with the hash: the records are sorted, with
+    // the records for one position adjacent.
+    size_t low = 0;
+    size_t high = book_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (record_hash(mid) < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
+    }
+
+    if (low == book_count || record_hash(low) != hash) {
+        return false;
+    }
 
-        // Load the values from the move entry.
-        // The first 8 bytes is the Zobrist hash of the position, the next 2 bytes is the response move.
-        uint64_t hash = ntohll(*(uint64_t *)entry);
-        uint16_t move = ntohs(*(uint16_t *)(entry + 8));
-        int to_file = (move >> TO_FILE_SHIFT) & MOVE_VALUE_MASK;
-        int to_row = (move >> TO_ROW_SHIFT) & MOVE_VALUE_MASK;
-        int from_file = (move >> FROM_FILE_SHIFT) & MOVE_VALUE_MASK;
-        int from_row = (move >> FROM_ROW_SHIFT) & MOVE_VALUE_MASK;
-        int promo_piece = (move >> PROMO_PIECE_SHIFT) & MOVE_VALUE_MASK;
-
-        // Promoting to pieces other than queen is unsupported.
-        if (promo_piece != PROMO_PIECE_NONE && promo_piece != PROMO_PIECE_QUEEN) {
-            continue;
+    // Decode the run of records with this hash.
+    // The move count is stored as a uint8, so a max of 255 moves per hash can be stored.
+    item_out->hash = hash;
+    item_out->moves_count = 0;
+
+    for (size_t i = low; i < book_count && record_hash(i) == hash && item_out->moves_count < UINT8_MAX; i++) {
+        if (record_move(i, &item_out->moves[item_out->moves_count])) {
+            item_out->moves_count++;
         }
+    }
+
+    // Every record for the hash may have been an unsupported promotion.
+    return item_out->moves_count > 0;
+}
 
-        // Row 0 is the bottom in the Polyglot BIN format (backwards compared to the scheme used for BoardPos).
-        struct BoardPos from = BoardPos(from_file, 7 - from_row);
-        struct BoardPos to = BoardPos(to_file, 7 - to_row);
-        struct Move actual_move = {from, to};
+// Initialise the opening book by memory mapping the opening book file.
+// The mapping must be released using deinit_opening_book().
+void init_opening_book() {
+#ifdef _WIN32
+    book_file = CreateFileA("res/opening_book.bin", GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (book_file == INVALID_HANDLE_VALUE) {
+        fputs("error initialising opening book\n", stderr);
+        exit(EXIT_FAILURE);
+    }
 
-        if (items_count != 0 && items[items_count - 1].hash == hash) {
-            struct OpeningItem *item = &items[items_count - 1];
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(book_file, &file_size)) {
+        fputs("error initialising opening book\n", stderr);
+        exit(EXIT_FAILURE);
+    }
 
-            // The move count is stored as a uint8, so a max
-            // of 255 moves per hash can be stored
-            if (item->moves_count == UINT8_MAX) {
-                continue;
-            }
+    book_mapping = CreateFileMappingA(book_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    book = book_mapping ? MapViewOfFile(book_mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (book == NULL) {
+        fputs("error initialising opening book\n", stderr);
+        exit(EXIT_FAILURE);
+    }
 
-            item->moves_count += 1;
-            item->moves = realloc(item->moves, sizeof(struct Move) * item->moves_count);
-            item->moves[item->moves_count - 1] = actual_move;
-        } else {
-            struct OpeningItem item = {.hash = hash, .moves = NULL, .moves_count = 1};
-            item.moves = malloc(sizeof(struct Move));
-            item.moves[0] = actual_move;
-            items[items_count++] = item;
-        }
+    book_count = (size_t)file_size.QuadPart / ENTRY_SIZE;
+#else
+    int fd = open("res/opening_book.bin", O_RDONLY);
+    if (fd < 0) {
+        perror("error initialising opening book");
+        exit(EXIT_FAILURE);
     }
 
-    fclose(book_file);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        perror("error initialising opening book");
+        exit(EXIT_FAILURE);
+    }
+
+    book_size = file_stat.st_size;
+    book = mmap(NULL, book_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file.
+    close(fd);
+
+    if (book == MAP_FAILED) {
+        perror("error initialising opening book");
+        exit(EXIT_FAILURE);
+    }
+
+    book_count = book_size / ENTRY_SIZE;
+#endif
 
     // If no items were found in the book it is invalid.
-    if (items_count == 0) {
+    if (book_count == 0) {
         fprintf(stderr, "error: invalid opening book file");
         exit(EXIT_FAILURE);
     }
-
-    // Shrink the items array down to the minimum size.
-    items = realloc(items, sizeof(struct OpeningItem) * items_count);
 }
 
-// Deinitialise and deallocate the opening book currently loaded
+// Deinitialise the opening book, unmapping the book file
 void deinit_opening_book() {
-    for (unsigned int i = 0; i < items_count; i++) {
-        free(items[i].moves);
-    }
-
-    free(items);
-    items = NULL;
-    items_count = 0;
+#ifdef _WIN32
+    if (book != NULL) UnmapViewOfFile(book);
+    if (book_mapping != NULL) CloseHandle(book_mapping);
+    if (book_file != INVALID_HANDLE_VALUE) CloseHandle(book_file);
+    book_mapping = NULL;
+    book_file = INVALID_HANDLE_VALUE;
+#else
+    if (book != NULL) munmap((void *)book, book_size);
+    book_size = 0;
+#endif
+
+    book = NULL;
+    book_count = 0;
 }
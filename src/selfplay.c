@@ -0,0 +1,306 @@
+// The main function for the chess-selfplay target: plays a headless match between two engine
+// configurations to measure whether a change costs strength, with W/L/D statistics instead of
+// hand-played GUI games.
+//
+//     chess-selfplay <games> <depth A> <depth B> [pgn file]
+//
+// The configurations are fixed search depths, which is the axis one binary can vary; comparing
+// two builds (an old against a new evaluation, say) is done by running each side's binary on the
+// suite positions instead - this harness measures one binary against itself at different depths,
+// or equal depths as a sanity check (which should score near 50%).
+//
+// Games run concurrently, one per thread pool worker (set CHESS_NPROC to use more cores). Every
+// game is played on its own GameState, and each side of each game searches into its own
+// transposition table instance, selected on the worker thread around the search (tptable_select)
+// so the configurations under test cannot read each other's entries. The searches run through
+// search_fixed_depth: synchronous, no helpers, no time limits, so results depend only on the
+// depths under test and not on machine load.
+//
+// Openings are drawn from the opening book for variety. Games are paired: both games of a pair
+// follow the same book line with the colours swapped, so an unbalanced opening does not bias the
+// match. The book line of a pair is chosen by a small private generator seeded with the pair
+// index, keeping reruns of the same match reproducible.
+//
+// The summary reports wins/losses/draws for configuration A, the score, an Elo difference
+// estimate and the likelihood of superiority (LOS), which is the SPRT-style stopping number:
+// keep adding games until LOS settles near 1 (A is stronger), near 0 (weaker), or the error
+// bars make the difference irrelevant.
+//
+// With a PGN file argument every game is appended to it as PGN. The movetext uses the engine's
+// algebraic notation (move_to_str), which omits disambiguation and check marks, so the odd move
+// may need fixing up before a strict importer accepts it.
+
+#include <bitboard.h>
+#include <chess.h>
+#include <config.h>
+#include <engine.h>
+#include <fen.h>
+#include <inttypes.h>
+#include <kpk.h>
+#include <math.h>
+#include <openings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threadpool.h>
+#include <tptable.h>
+#include <util.h>
+
+static const char *START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// The size of each per-game transposition table instance, in megabytes. Two tables exist per
+// game in flight (one per side), so this is kept well below TPTABLE_DEFAULT_MB.
+#define SELFPLAY_TT_MB 16
+
+// Games longer than this many plies are adjudicated as draws, so a pair of shuffling engines
+// cannot stall the match (the fifty-move rule normally ends such games much earlier).
+#define SELFPLAY_MAX_PLIES 400
+
+// The largest PGN movetext a game can produce: a move number, two moves and their separators
+// fit comfortably in 16 characters per ply.
+#define SELFPLAY_PGN_MAX (SELFPLAY_MAX_PLIES * 16)
+
+enum GameOutcome { OutcomeAWins, OutcomeBWins, OutcomeDraw };
+
+// One match game, submitted as a thread pool task. The settings are filled by main and the
+// outcome by the task.
+struct GameTaskArg {
+    int game_index;          // Games are paired: game 2n and 2n+1 play the same opening with colours swapped
+    int depth_a;             // Search depth of configuration A
+    int depth_b;             // Search depth of configuration B
+    FILE *pgn_file;          // Shared PGN output file, or NULL
+    enum GameOutcome outcome;
+    const char *termination; // Why the game ended, a static string
+    int plies;               // Game length, including the book moves
+};
+
+// A small private random generator (xorshift*), so concurrent games do not share the libc rand
+// state and a rerun of the same match plays the same openings.
+static uint64_t rng_next(uint64_t *rng_state) {
+    uint64_t x = *rng_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rng_state = x;
+    return x * UINT64_C(2685821657736338717);
+}
+
+// Returns true if the current position has occurred twice before in the game, which draws it by
+// threefold repetition. The scan mirrors the search's is_draw_by_rule (engine.c): a repetition
+// has the same side to move and no position before an irreversible move can repeat, so only
+// even offsets within the halfmove clock need checking.
+static bool is_threefold_repetition(struct GameState *state) {
+    int repeats = 0;
+    int limit = MIN(state->halfmove_clock, state->move_count);
+    for (int back = 4; back <= limit; back += 2) {
+        if (state->hash_history[(state->move_count - back) % HASH_HISTORY_MAX] == state->hash) {
+            repeats++;
+        }
+    }
+    return repeats >= 2;
+}
+
+// Serialises the PGN appends of concurrent games.
+#ifdef HAS_C11_CONCURRENCY
+static once_flag pgn_mtx_once = ONCE_FLAG_INIT;
+static mtx_t pgn_mtx;
+static void pgn_mtx_init(void) { mtx_init(&pgn_mtx, mtx_plain); }
+#endif
+
+// Appends one finished game to the PGN file.
+static void write_pgn(struct GameTaskArg *arg, const char *movetext, const char *result) {
+#ifdef HAS_C11_CONCURRENCY
+    call_once(&pgn_mtx_once, pgn_mtx_init);
+    mtx_lock(&pgn_mtx);
+#endif
+    bool a_is_white = arg->game_index % 2 == 0;
+    fprintf(arg->pgn_file, "[Event \"selfplay\"]\n[Round \"%d\"]\n", arg->game_index + 1);
+    fprintf(arg->pgn_file, "[White \"depth %d\"]\n[Black \"depth %d\"]\n",
+            a_is_white ? arg->depth_a : arg->depth_b, a_is_white ? arg->depth_b : arg->depth_a);
+    fprintf(arg->pgn_file, "[Result \"%s\"]\n[Termination \"%s\"]\n\n%s%s\n\n", result, arg->termination,
+            movetext, result);
+    fflush(arg->pgn_file);
+#ifdef HAS_C11_CONCURRENCY
+    mtx_unlock(&pgn_mtx);
+#endif
+}
+
+// Plays one game and records its outcome in the arg. Runs as a thread pool task; the arg is
+// owned by main, which reads the outcomes after waiting for the batch.
+static void game_task(struct GameTaskArg *arg) {
+    struct GameState *state = fen_to_gamestate(START_FEN);
+    struct TPTable *table_a = tptable_create(SELFPLAY_TT_MB);
+    struct TPTable *table_b = tptable_create(SELFPLAY_TT_MB);
+
+    // Both games of a pair draw the same book line; A takes white in the even game.
+    uint64_t rng_state = (uint64_t)(arg->game_index / 2) * 2 + 1;
+    bool a_is_white = arg->game_index % 2 == 0;
+
+    char *movetext = arg->pgn_file != NULL ? malloc(SELFPLAY_PGN_MAX) : NULL;
+    size_t movetext_len = 0;
+
+    enum GameOutcome outcome = OutcomeDraw;
+    arg->termination = "move limit";
+
+    while (state->move_count < SELFPLAY_MAX_PLIES) {
+        enum Player to_move = state->white_to_move ? WhitePlayer : BlackPlayer;
+
+        // Game over checks, before asking for a move.
+        if (is_player_checkmated(state, to_move)) {
+            bool white_wins = to_move == BlackPlayer;
+            outcome = white_wins == a_is_white ? OutcomeAWins : OutcomeBWins;
+            arg->termination = "checkmate";
+            break;
+        }
+        if (is_stalemate(state)) {
+            arg->termination = "stalemate";
+            break;
+        }
+        if (state->halfmove_clock >= 100) {
+            arg->termination = "fifty-move rule";
+            break;
+        }
+        if (is_threefold_repetition(state)) {
+            arg->termination = "threefold repetition";
+            break;
+        }
+
+        // Play from the opening book while it has a move for the position, then search. The
+        // moves decode into this worker's own buffer, so concurrent games can probe the book
+        // freely. An illegal book move (a hash collision) falls through to the search.
+        struct Move move = {NULL_BOARDPOS, NULL_BOARDPOS};
+        struct OpeningItem opening;
+        if (find_opening_by_hash(state->hash, &opening)) {
+            move = opening.moves[rng_next(&rng_state) % opening.moves_count];
+            if (!is_move_legal(state, move)) move = (struct Move){NULL_BOARDPOS, NULL_BOARDPOS};
+        }
+        if (boardpos_eq(move.from, NULL_BOARDPOS)) {
+            bool a_to_move = (to_move == WhitePlayer) == a_is_white;
+            tptable_select(a_to_move ? table_a : table_b);
+
+            struct SearchResult result;
+            search_fixed_depth(state, a_to_move ? arg->depth_a : arg->depth_b, &result);
+            tptable_select(NULL);
+
+            // No legal move should mean mate or stalemate, which were checked above; bail out
+            // as a draw rather than loop if the search ever fails to produce one anyway.
+            if (boardpos_eq(result.best_move.from, NULL_BOARDPOS)) {
+                arg->termination = "no move";
+                break;
+            }
+            move = result.best_move;
+        }
+
+        if (movetext != NULL && movetext_len + 32 < SELFPLAY_PGN_MAX) {
+            if (state->white_to_move) {
+                movetext_len += sprintf(movetext + movetext_len, "%d. ", state->move_count / 2 + 1);
+            }
+            movetext_len += move_to_str(state, move.from, move.to, movetext + movetext_len);
+            movetext[movetext_len++] = ' ';
+            movetext[movetext_len] = '\0';
+        }
+
+        make_move(state, move, true);
+    }
+
+    arg->outcome = outcome;
+    arg->plies = state->move_count;
+
+    if (arg->pgn_file != NULL) {
+        const char *result = outcome == OutcomeDraw ? "1/2-1/2"
+                             : (outcome == OutcomeAWins) == a_is_white ? "1-0"
+                                                                       : "0-1";
+        write_pgn(arg, movetext, result);
+        free(movetext);
+    }
+
+    printf("game %d: %s (%s, %d plies)\n", arg->game_index + 1,
+           outcome == OutcomeDraw ? "draw" : outcome == OutcomeAWins ? "A wins" : "B wins",
+           arg->termination, arg->plies);
+
+    tptable_destroy(table_a);
+    tptable_destroy(table_b);
+    deinit_gamestate(state);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        printf("usage: %s <games> <depth A> <depth B> [pgn file]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int games = atoi(argv[1]);
+    int depth_a = atoi(argv[2]);
+    int depth_b = atoi(argv[3]);
+    if (games <= 0 || depth_a <= 0 || depth_b <= 0) {
+        printf("usage: %s <games> <depth A> <depth B> [pgn file]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *pgn_file = NULL;
+    if (argc > 4) {
+        pgn_file = fopen(argv[4], "a");
+        if (pgn_file == NULL) {
+            printf("cannot open pgn file %s\n", argv[4]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Line buffer stdout even when piped, so the per-game lines appear as the games finish.
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    init_opening_book();
+    bitboard_init();
+    kpk_init();
+    // The default table exists but goes unused: every search selects a per-game instance.
+    tptable_init(1);
+
+    struct ThreadPool *pool = threadpool_init();
+
+    struct GameTaskArg *args = calloc(games, sizeof(*args));
+    struct TaskBatch batch;
+    taskbatch_init(&batch);
+
+    for (int i = 0; i < games; i++) {
+        args[i].game_index = i;
+        args[i].depth_a = depth_a;
+        args[i].depth_b = depth_b;
+        args[i].pgn_file = pgn_file;
+        threadpool_submit(pool, (TaskFunc)game_task, &args[i], &batch);
+    }
+
+    threadpool_wait(pool, &batch);
+
+    int wins = 0;
+    int losses = 0;
+    int draws = 0;
+    for (int i = 0; i < games; i++) {
+        if (args[i].outcome == OutcomeAWins) wins++;
+        else if (args[i].outcome == OutcomeBWins) losses++;
+        else draws++;
+    }
+
+    // The score of configuration A, counting draws as half a point.
+    double score = (wins + 0.5 * draws) / games;
+
+    printf("A (depth %d) vs B (depth %d): +%d -%d =%d, score %.1f%%\n", depth_a, depth_b, wins, losses,
+           draws, score * 100.0);
+
+    // The logistic Elo difference the score corresponds to, and the likelihood of superiority:
+    // the probability that A is genuinely stronger given the win/loss counts (draws carry no
+    // information about the sign of the difference).
+    if (score > 0.0 && score < 1.0) {
+        printf("elo difference %+.1f\n", -400.0 * log10(1.0 / score - 1.0));
+    }
+    if (wins + losses > 0) {
+        printf("LOS %.1f%%\n", 100.0 * 0.5 * (1.0 + erf((wins - losses) / sqrt(2.0 * (wins + losses)))));
+    }
+
+    free(args);
+    if (pgn_file != NULL) fclose(pgn_file);
+    threadpool_deinit(pool);
+    tptable_deinit();
+    deinit_opening_book();
+
+    return EXIT_SUCCESS;
+}
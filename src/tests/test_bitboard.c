@@ -0,0 +1,73 @@
+#include <bitboard.h>
+#include <chess.h>
+#include <engine.h>
+
+static int test_rook_attacks_blocked() {
+    // A rook on an empty board attacks 14 squares; a blocker on its rank stops the ray at the
+    // blocker's square (the blocker itself is included in the attack set).
+    int sq = bb_square(BoardPos(3, 3));
+
+    Bitboard empty = bb_rook_attacks(sq, 0);
+    TEST_ASSERT(bb_popcount(empty) == 14, "expected 14 rook attack squares on an empty board");
+
+    Bitboard blocker = bb_from_pos(BoardPos(5, 3));
+    Bitboard blocked = bb_rook_attacks(sq, blocker);
+    TEST_ASSERT(blocked & blocker, "expected the blocker square to be attacked");
+    TEST_ASSERT(!(blocked & bb_from_pos(BoardPos(6, 3))), "expected the square behind the blocker to not be attacked");
+    TEST_ASSERT(!(blocked & bb_from_pos(BoardPos(7, 3))), "expected the square behind the blocker to not be attacked");
+    return 0;
+}
+
+static int test_knight_attacks_corner() {
+    // A knight in the corner attacks exactly two squares.
+    Bitboard attacks = bb_knight_attacks(bb_square(BoardPos(0, 0)));
+    TEST_ASSERT(bb_popcount(attacks) == 2, "expected 2 knight attack squares from the corner");
+    TEST_ASSERT(attacks & bb_from_pos(BoardPos(1, 2)), "expected knight to attack (1, 2)");
+    TEST_ASSERT(attacks & bb_from_pos(BoardPos(2, 1)), "expected knight to attack (2, 1)");
+    return 0;
+}
+
+// Recomputes a state's occupancy bitboards from the board array and compares them with the
+// incrementally maintained ones.
+static int check_bitboards_match_board(struct GameState *state) {
+    Bitboard bb_type[7] = {0};
+    Bitboard bb_player[2] = {0};
+
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            struct Piece piece = get_piece(state, BoardPos(file, rank));
+            if (piece.type == Empty) continue;
+            bb_type[piece.type] |= bb_from_pos(BoardPos(file, rank));
+            bb_player[piece.player] |= bb_from_pos(BoardPos(file, rank));
+        }
+    }
+
+    for (int i = 1; i < 7; i++) {
+        if (bb_type[i] != state->bb_type[i]) return -1;
+    }
+
+    return (bb_player[WhitePlayer] == state->bb_player[WhitePlayer] &&
+            bb_player[BlackPlayer] == state->bb_player[BlackPlayer])
+               ? 0
+               : -1;
+}
+
+static int test_bitboards_in_sync() {
+    struct GameState *state = init_gamestate();
+    TEST_ASSERT(check_bitboards_match_board(state) == 0, "bitboards out of sync after init_gamestate");
+
+    // Make and unmake a move, the bitboards must track the board exactly.
+    struct MoveUndo undo;
+    make_move_undoable(state, (struct Move){BoardPos(4, 6), BoardPos(4, 4)}, &undo, true);
+    bool in_sync_after_move = check_bitboards_match_board(state) == 0;
+    unmake_move(state, &undo);
+    bool in_sync_after_unmake = check_bitboards_match_board(state) == 0;
+
+    deinit_gamestate(state);
+
+    TEST_ASSERT(in_sync_after_move, "bitboards out of sync after make_move_undoable");
+    TEST_ASSERT(in_sync_after_unmake, "bitboards out of sync after unmake_move");
+    return 0;
+}
+
+DEF_TEST_MODULE(bitboard, test_rook_attacks_blocked, test_knight_attacks_corner, test_bitboards_in_sync);
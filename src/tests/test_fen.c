@@ -23,9 +23,26 @@ static int test_serialize_normal() {
     char fen[90];
     gamestate_to_fen(starting_state, fen);
     deinit_gamestate(starting_state);
-    TEST_ASSERT(strncmp(fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 0", 57) == 0,
+    TEST_ASSERT(strncmp(fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 57) == 0,
                 "the serialised FEN of the starting GameState does not match the expected value");
     return 0;
 }
 
-DEF_TEST_MODULE(fen, test_parse_normal, test_serialize_normal);
+// The halfmove clock and fullmove number must survive a parse/serialise round trip,
+// as the fifty-move rule depends on the parsed clock.
+static int test_clock_roundtrip() {
+    static const char *test_string = "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 13 42";
+
+    struct GameState *state = fen_to_gamestate(test_string);
+    TEST_ASSERT(state != NULL, "unexpected error in fen_to_gamestate");
+    TEST_ASSERT(state->halfmove_clock == 13, "the halfmove clock was not parsed from the FEN");
+
+    char fen[90];
+    gamestate_to_fen(state, fen);
+    deinit_gamestate(state);
+    TEST_ASSERT(strcmp(fen, test_string) == 0, "the FEN did not survive a parse/serialise round trip");
+
+    return 0;
+}
+
+DEF_TEST_MODULE(fen, test_parse_normal, test_serialize_normal, test_clock_roundtrip);
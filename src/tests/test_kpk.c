@@ -0,0 +1,58 @@
+#include <engine.h>
+#include <fen.h>
+#include <kpk.h>
+#include <stdbool.h>
+
+// Generates the bitbase once for all tests in this module; the tests run before main's init
+// calls when CHESS_TEST is defined.
+static void ensure_kpk() {
+    static bool generated = false;
+    if (!generated) {
+        kpk_init();
+        generated = true;
+    }
+}
+
+// Positions below are given in algebraic terms in the comments; BoardPos ranks count from
+// black's side, so algebraic rank r is BoardPos rank 8 - r.
+
+static int test_kpk_probe_win() {
+    ensure_kpk();
+    // Kf6, Pe6 vs Ke8, white to move: 1. e7 and the pawn promotes.
+    bool win = kpk_probe(BoardPos(5, 2), BoardPos(4, 0), BoardPos(4, 2), true);
+    TEST_ASSERT(win, "expected kpk_probe() == true, got false");
+    return 0;
+}
+
+static int test_kpk_probe_draw_behind_pawn() {
+    ensure_kpk();
+    // Ke5, Pe6 vs Ke8, white to move: the king is behind its pawn and black keeps the
+    // opposition; the pawn can only promote into a stalemate.
+    bool win = kpk_probe(BoardPos(4, 3), BoardPos(4, 0), BoardPos(4, 2), true);
+    TEST_ASSERT(!win, "expected kpk_probe() == false, got true");
+    return 0;
+}
+
+static int test_kpk_probe_draw_rook_pawn() {
+    ensure_kpk();
+    // Kg6, Ph6 vs Kh8, white to move: a rook pawn with the defending king in the corner is the
+    // classic draw. Also exercises the file mirroring, as the pawn is on the kingside.
+    bool win = kpk_probe(BoardPos(6, 2), BoardPos(7, 0), BoardPos(7, 2), true);
+    TEST_ASSERT(!win, "expected kpk_probe() == false, got true");
+    return 0;
+}
+
+static int test_kpk_position_value_black_pawn() {
+    ensure_kpk();
+    // The mirror of the won position with colours swapped: Kf3, Pe3 vs Ke1, black to move.
+    // position_value must detect the KPK material and score it decisively for black.
+    struct GameState *state = fen_to_gamestate("8/8/8/8/8/4pk2/8/4K3 b - - 0 1");
+    int value = position_value(state);
+    deinit_gamestate(state);
+
+    TEST_ASSERT(value < -500, "expected a decisive negative value for black");
+    return 0;
+}
+
+DEF_TEST_MODULE(kpk, test_kpk_probe_win, test_kpk_probe_draw_behind_pawn, test_kpk_probe_draw_rook_pawn,
+                test_kpk_position_value_black_pawn);
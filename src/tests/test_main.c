@@ -38,10 +38,16 @@ static void _test_run_test_module(TestFunction *tests) {
     printf("\t%d/%d tests passed\n", passed, i);
 }
 
+#include "test_bitboard.c"
 #include "test_engine.c"
 #include "test_fen.c"
+#include "test_kpk.c"
+#include "test_tptable.c"
 
 void test_main() {
+    RUN_TEST_MODULE(bitboard);
     RUN_TEST_MODULE(engine);
     RUN_TEST_MODULE(fen);
+    RUN_TEST_MODULE(kpk);
+    RUN_TEST_MODULE(tptable);
 }
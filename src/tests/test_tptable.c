@@ -0,0 +1,61 @@
+#include <chess.h>
+#include <tptable.h>
+
+static int test_put_get_roundtrip() {
+    tptable_init(1);
+
+    struct TranspositionEntry entry = {.hash = 0xdeadbeefcafeULL,
+                                       .best_move = (struct Move){BoardPos(4, 6), BoardPos(4, 4)},
+                                       .depth = 5,
+                                       .value = -42,
+                                       .type = EntryTypeLower};
+    tptable_put(entry);
+
+    struct TranspositionEntry out = tptable_get(entry.hash);
+    tptable_deinit();
+
+    TEST_ASSERT(out.hash == entry.hash, "expected the entry hash to survive the pack/unpack roundtrip");
+    TEST_ASSERT(out.depth == entry.depth, "expected the entry depth to survive the pack/unpack roundtrip");
+    TEST_ASSERT(out.value == entry.value, "expected the (negative) entry value to survive the pack/unpack roundtrip");
+    TEST_ASSERT(out.type == entry.type, "expected the entry type to survive the pack/unpack roundtrip");
+    TEST_ASSERT(boardpos_eq(out.best_move.from, entry.best_move.from) && boardpos_eq(out.best_move.to, entry.best_move.to),
+                "expected the best move to survive the pack/unpack roundtrip");
+    return 0;
+}
+
+static int test_get_missing() {
+    tptable_init(1);
+
+    // A probe of a hash which was never stored must miss, returning a depth 0 entry with no move.
+    struct TranspositionEntry out = tptable_get(0x1111222233334444ULL);
+    tptable_deinit();
+    TEST_ASSERT(out.depth == 0, "expected a missing hash to probe as depth 0");
+    TEST_ASSERT(boardpos_eq(out.best_move.from, NULL_BOARDPOS), "expected a missing hash to have no best move");
+    return 0;
+}
+
+static int test_bucket_collisions() {
+    tptable_init(1);
+
+    // Hashes differing only above the index bits map to the same bucket; with four slots per
+    // bucket they must all survive together instead of evicting each other.
+    for (uint64_t i = 1; i <= 4; i++) {
+        struct TranspositionEntry entry = {.hash = i << 60,
+                                           .best_move = (struct Move){BoardPos(0, 1), BoardPos(0, 3)},
+                                           .depth = (char)i,
+                                           .value = (int)i,
+                                           .type = EntryTypeExact};
+        tptable_put(entry);
+    }
+
+    int found = 0;
+    for (uint64_t i = 1; i <= 4; i++) {
+        found += tptable_get(i << 60).depth == (char)i;
+    }
+    tptable_deinit();
+
+    TEST_ASSERT(found == 4, "expected four colliding hashes to share a bucket without evictions");
+    return 0;
+}
+
+DEF_TEST_MODULE(tptable, test_put_get_roundtrip, test_get_missing, test_bucket_collisions);
@@ -24,164 +24,379 @@ static unsigned long nproc() {
 }
 
 #ifdef HAS_C11_CONCURRENCY
+
 static void check_err(int ret) {
     if (ret != thrd_success) {
         puts("threadpool c11threads error");
         exit(EXIT_FAILURE);
     }
 }
-#endif
 
-// Enqueues a task. Returns false if the queue is full.
-// Thread safe
-#ifdef HAS_C11_CONCURRENCY
-static bool enqueue(struct ThreadPool *pool, struct Task task) {
-    check_err(mtx_lock(&pool->mutex));
+// One worker's Chase-Lev work-stealing deque (Le et al., "Correct and Efficient Work-Stealing
+// for Weak Memory Models"). The owning worker pushes and pops at the bottom; other workers steal
+// from the top, so in the common case taking a task is a couple of atomic operations and the
+// only contention is the compare-exchange on `top` when the deque is nearly empty.
+// `top` and `bottom` increase without bound and are reduced modulo the (power of two) capacity
+// on access; the capacity check in deque_push keeps unstolen slots from being overwritten.
+struct WSDeque {
+    atomic_size_t top;     // Index of the next task to steal
+    atomic_size_t bottom;  // Index where the owner pushes the next task
+    struct Task buf[THREADPOOL_QUEUE_SIZE];
+};
+
+// Pushes a task onto the bottom of the deque. Owner only.
+// Returns false if the deque is full.
+static bool deque_push(struct WSDeque *dq, struct Task task) {
+    size_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    size_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+
+    if (b - t >= THREADPOOL_QUEUE_SIZE) {
+        return false;
+    }
 
-    if (pool->queue_back == pool->queue_front) {
-        check_err(mtx_unlock(&pool->mutex));
+    dq->buf[b % THREADPOOL_QUEUE_SIZE] = task;
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+// Pops a task from the bottom of the deque. Owner only.
+// Returns false if the deque is empty (or the last task was stolen first).
+static bool deque_pop(struct WSDeque *dq, struct Task *out) {
+    size_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    size_t t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+    if ((ptrdiff_t)(b - t) < 0) {
+        // The deque was empty; undo the bottom decrement.
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
         return false;
     }
 
-    size_t inserted_at = pool->queue_back;
-    pool->queue[pool->queue_back] = task;
-    pool->queue_back = (pool->queue_back + 1) % THREADPOOL_QUEUE_SIZE;
+    *out = dq->buf[b % THREADPOOL_QUEUE_SIZE];
 
-    if (pool->queue_front == THREADPOOL_QUEUE_SIZE) {
-        pool->queue_front = inserted_at;
+    if (b == t) {
+        // Taking the last task races with the stealers, which is settled by whoever advances
+        // `top` first.
+        bool won = atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1, memory_order_seq_cst,
+                                                           memory_order_relaxed);
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        return won;
     }
 
-    check_err(mtx_unlock(&pool->mutex));
     return true;
 }
-#endif
 
-// Dequeues a task. Returns false if the queue is empty.
-// Caller must lock the mutex.
-#ifdef HAS_C11_CONCURRENCY
-static bool dequeue_already_locked(struct ThreadPool *pool, struct Task *task) {
-    if (pool->queue_back == pool->queue_front || pool->queue_front == THREADPOOL_QUEUE_SIZE) {
+// Steals a task from the top of another worker's deque.
+// Returns false if the deque is empty or the steal lost a race (the caller just moves on to the
+// next deque, so a lost race is not retried here).
+static bool deque_steal(struct WSDeque *dq, struct Task *out) {
+    size_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    size_t b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    if ((ptrdiff_t)(b - t) <= 0) {
         return false;
     }
 
-    *task = pool->queue[pool->queue_front];
-    pool->queue_front = (pool->queue_front + 1) % THREADPOOL_QUEUE_SIZE;
+    *out = dq->buf[t % THREADPOOL_QUEUE_SIZE];
+    return atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+}
 
-    if (pool->queue_back == pool->queue_front) {
-        pool->queue_front = THREADPOOL_QUEUE_SIZE;
+// Which pool (and which worker index in it) the current thread belongs to, so threadpool_submit
+// can push to the submitting worker's own deque instead of the shared inbox.
+static _Thread_local struct ThreadPool *tls_pool = NULL;
+static _Thread_local size_t tls_worker_index = 0;
+
+// Runs a task, with the batch bookkeeping: tasks of a cancelled batch are completed without
+// calling their function, and the last task of a batch wakes any threadpool_wait callers.
+static void run_task(struct ThreadPool *pool, struct Task task) {
+    if (task.batch == NULL) {
+        task.func(task.arg);
+        return;
     }
 
-    return true;
-}
-#endif
+    if (!atomic_load_explicit(&task.batch->cancelled, memory_order_relaxed)) {
+        task.func(task.arg);
+    }
 
-#ifdef HAS_C11_CONCURRENCY
-static int thread_start_func(struct ThreadPool *pool) {
-    for (;;) {
+    if (atomic_fetch_sub(&task.batch->remaining, 1) == 1) {
+        // Last task of the batch. The broadcast is taken under the mutex so it cannot slip
+        // between a waiter's check of `remaining` and its cnd_wait.
         check_err(mtx_lock(&pool->mutex));
+        check_err(cnd_broadcast(&pool->batch_finished));
+        check_err(mtx_unlock(&pool->mutex));
+    }
+}
 
-        struct Task task;
-        if (dequeue_already_locked(pool, &task)) {
-            goto got_task;
-        } else {
-            check_err(cnd_wait(&pool->task_available, &pool->mutex));
-        }
+// Takes a task from the shared inbox, if there is one, making room for a blocked submitter.
+static bool inbox_take(struct ThreadPool *pool, struct Task *out) {
+    bool got = false;
 
-        if (!dequeue_already_locked(pool, &task)) {
-            // Should never happen
-            check_err(mtx_unlock(&pool->mutex));
-            break;
-        }
+    check_err(mtx_lock(&pool->mutex));
+    if (pool->inbox_count > 0) {
+        *out = pool->inbox[pool->inbox_front];
+        pool->inbox_front = (pool->inbox_front + 1) % THREADPOOL_QUEUE_SIZE;
+        pool->inbox_count -= 1;
+        got = true;
+        check_err(cnd_signal(&pool->inbox_space));
+    }
+    check_err(mtx_unlock(&pool->mutex));
 
-    got_task:
-        check_err(mtx_unlock(&pool->mutex));
+    return got;
+}
 
-        // Return value of false is a stop request.
-        if (!task.func(task.arg)) {
-            break;
-        }
+// Finds the next task for a worker: its own deque first (newest first, which keeps the data the
+// task touches warm), then the shared inbox, then a steal sweep over the other workers' deques.
+static bool worker_find_task(struct ThreadPool *pool, size_t self, struct Task *out) {
+    if (deque_pop(&pool->deques[self], out)) {
+        return true;
     }
 
-    atomic_fetch_sub(&pool->thread_count, 1);
+    if (inbox_take(pool, out)) {
+        return true;
+    }
 
-    return 0;
-}
-#endif
+    for (size_t i = 1; i < pool->worker_count; i++) {
+        if (deque_steal(&pool->deques[(self + i) % pool->worker_count], out)) {
+            return true;
+        }
+    }
 
-static bool task_stop(void *_arg) {
-    (void)_arg;
     return false;
 }
 
-// Terminates all threads in the pool
-// Must be called on the thread which created the pool
-#ifdef HAS_C11_CONCURRENCY
-static void threadpool_stop(struct ThreadPool *pool) {
-    struct Task stop = {.func = task_stop, .arg = NULL};
+struct WorkerArg {
+    struct ThreadPool *pool;
+    size_t index;
+};
 
-    while (atomic_load(&pool->thread_count) > 0) {
-        while (!enqueue(pool, stop)) {
+static int thread_start_func(void *arg_void) {
+    struct WorkerArg *arg = arg_void;
+    struct ThreadPool *pool = arg->pool;
+    size_t self = arg->index;
+    free(arg);
+
+    tls_pool = pool;
+    tls_worker_index = self;
+
+    for (;;) {
+        struct Task task;
+        if (worker_find_task(pool, self, &task)) {
+            atomic_fetch_sub(&pool->pending, 1);
+            run_task(pool, task);
+            continue;
+        }
+
+        // Nothing found anywhere; sleep until a submit arrives. `pending` is re-checked under
+        // the mutex the submitters signal under, so a submit between the failed scan above and
+        // the wait cannot be missed.
+        check_err(mtx_lock(&pool->mutex));
+        while (atomic_load(&pool->pending) == 0 && !atomic_load(&pool->shutdown)) {
+            check_err(cnd_wait(&pool->task_available, &pool->mutex));
+        }
+        bool quit = atomic_load(&pool->shutdown) && atomic_load(&pool->pending) == 0;
+        check_err(mtx_unlock(&pool->mutex));
+
+        if (quit) {
+            break;
         }
-        check_err(cnd_signal(&pool->task_available));
     }
+
+    atomic_fetch_sub(&pool->thread_count, 1);
+    return 0;
 }
-#endif
 
-// Creates a new ThreadPool.
-// Must be deallocated with threadpool_deinit
+#endif /* HAS_C11_CONCURRENCY */
+
+// Creates a new ThreadPool with one persistent worker per logical core.
+// Must be deallocated with threadpool_deinit.
 struct ThreadPool *threadpool_init() {
     struct ThreadPool *pool = malloc(sizeof(*pool));
 
-    pool->queue_front = THREADPOOL_QUEUE_SIZE;
-    pool->queue_back = 0;
+    pool->inbox_front = 0;
+    pool->inbox_count = 0;
+    pool->deques = NULL;
+    pool->worker_count = 0;
 
 #ifdef HAS_C11_CONCURRENCY
     check_err(mtx_init(&pool->mutex, mtx_plain));
     check_err(cnd_init(&pool->task_available));
+    check_err(cnd_init(&pool->inbox_space));
+    check_err(cnd_init(&pool->batch_finished));
 
     size_t thread_count = nproc();
+    pool->worker_count = thread_count;
+    atomic_init(&pool->pending, 0);
     atomic_init(&pool->thread_count, thread_count);
+    atomic_init(&pool->shutdown, false);
+
+    pool->deques = calloc(thread_count, sizeof(*pool->deques));
+    if (pool->deques == NULL) {
+        puts("threadpool alloc error");
+        exit(EXIT_FAILURE);
+    }
 
     printf("[threadpool] Starting %zu threads. To change set CHESS_NPROC environment variable.\n", thread_count);
 
     for (size_t i = 0; i < thread_count; i++) {
+        // Freed by the worker.
+        struct WorkerArg *arg = malloc(sizeof(*arg));
+        arg->pool = pool;
+        arg->index = i;
+
         thrd_t thread;
-        check_err(thrd_create(&thread, (thrd_start_t)thread_start_func, pool));
+        check_err(thrd_create(&thread, thread_start_func, arg));
         check_err(thrd_detach(thread));
     }
 #else
     printf("[threadpool] Compiled without C11 threads support. Thread pool will not be used.\n");
     pool->thread_count = 0;
+    pool->pending = 0;
+    pool->shutdown = false;
 #endif
 
     return pool;
 }
 
-// Enqueues a task on the thread pool.
-// If threading is unsupported or the queue is full
-// the task is immediately executed.
+// Submits a task to the pool, associated with `batch` if it is not NULL.
+// A task submitted from a pool worker goes onto that worker's own deque (and runs on the
+// submitting thread if the deque is full); a task submitted from outside goes through the shared
+// inbox, blocking when the inbox is full rather than dropping or reordering work.
+// If threading is unsupported the task runs immediately on the calling thread.
 // Thread safe.
-void threadpool_enqueue(struct ThreadPool *pool, TaskFunc func, void *arg) {
+void threadpool_submit(struct ThreadPool *pool, TaskFunc func, void *arg, struct TaskBatch *batch) {
 #ifdef HAS_C11_CONCURRENCY
-    struct Task task = {.func = func, .arg = arg};
+    struct Task task = {.func = func, .arg = arg, .batch = batch};
 
-    if (atomic_load(&pool->thread_count) == 0 || !enqueue(pool, task)) {
-        func(arg);
+    if (batch != NULL) {
+        atomic_fetch_add(&batch->remaining, 1);
+    }
+
+    if (atomic_load(&pool->thread_count) == 0) {
+        // No workers (the pool is shutting down); run the task here.
+        run_task(pool, task);
+        return;
+    }
+
+    if (tls_pool == pool) {
+        // Worker submitting to its own pool: lock-free push, or direct execution as the
+        // backpressure when the deque is full.
+        if (deque_push(&pool->deques[tls_worker_index], task)) {
+            atomic_fetch_add(&pool->pending, 1);
+            check_err(mtx_lock(&pool->mutex));
+            check_err(cnd_signal(&pool->task_available));
+            check_err(mtx_unlock(&pool->mutex));
+        } else {
+            run_task(pool, task);
+        }
+        return;
+    }
+
+    // External submitter: put the task in the inbox, waiting for room if it is full.
+    check_err(mtx_lock(&pool->mutex));
+    while (pool->inbox_count == THREADPOOL_QUEUE_SIZE) {
+        check_err(cnd_wait(&pool->inbox_space, &pool->mutex));
+    }
+    pool->inbox[(pool->inbox_front + pool->inbox_count) % THREADPOOL_QUEUE_SIZE] = task;
+    pool->inbox_count += 1;
+    atomic_fetch_add(&pool->pending, 1);
+    check_err(cnd_signal(&pool->task_available));
+    check_err(mtx_unlock(&pool->mutex));
+#else
+    if (batch != NULL) {
+        batch->remaining += 1;
+        if (!batch->cancelled) {
+            func(arg);
+        }
+        batch->remaining -= 1;
     } else {
-        check_err(cnd_signal(&pool->task_available));
+        func(arg);
+    }
+#endif
+}
+
+// Blocks until every task submitted with `batch` has finished (or been skipped by a cancel).
+// Without C11 threads the tasks already ran inside threadpool_submit, so this returns
+// immediately.
+void threadpool_wait(struct ThreadPool *pool, struct TaskBatch *batch) {
+#ifdef HAS_C11_CONCURRENCY
+    check_err(mtx_lock(&pool->mutex));
+    while (atomic_load(&batch->remaining) > 0) {
+        check_err(cnd_wait(&pool->batch_finished, &pool->mutex));
     }
+    check_err(mtx_unlock(&pool->mutex));
+#else
+    (void)pool;
+    (void)batch;
+#endif
+}
+
+// Initialises an empty batch. May be reused for a new round of submissions once
+// threadpool_wait has returned (cancellation is not reset by this, use taskbatch_init again).
+void taskbatch_init(struct TaskBatch *batch) {
+#ifdef HAS_C11_CONCURRENCY
+    atomic_init(&batch->remaining, 0);
+    atomic_init(&batch->cancelled, false);
 #else
-    func(arg);
+    batch->remaining = 0;
+    batch->cancelled = false;
 #endif
 }
 
-// Deallocates the pool and terminates all threads.
-// Must be called on the thread which created the pool
+// Cancels the batch: its tasks which have not started yet are completed without being run.
+// Note the task functions of skipped tasks are never called, so arguments owned by the tasks
+// themselves would leak; cancellation is meant for tasks whose arguments the submitter owns and
+// frees after threadpool_wait.
+void taskbatch_cancel(struct TaskBatch *batch) {
+#ifdef HAS_C11_CONCURRENCY
+    atomic_store(&batch->cancelled, true);
+#else
+    batch->cancelled = true;
+#endif
+}
+
+// Returns whether every task of the batch has finished. A single atomic load, so it can be
+// polled (e.g. once per frame) without touching the pool.
+bool taskbatch_done(struct TaskBatch *batch) {
+#ifdef HAS_C11_CONCURRENCY
+    return atomic_load(&batch->remaining) == 0;
+#else
+    return batch->remaining == 0;
+#endif
+}
+
+// Returns the number of worker threads in the pool (0 when compiled without C11 threads, where
+// submitted tasks run immediately on the calling thread).
+size_t threadpool_thread_count(struct ThreadPool *pool) {
+#ifdef HAS_C11_CONCURRENCY
+    return atomic_load(&pool->thread_count);
+#else
+    (void)pool;
+    return 0;
+#endif
+}
+
+// Deallocates the pool, terminating the workers once the queued tasks have drained.
+// Must be called on the thread which created the pool.
 void threadpool_deinit(struct ThreadPool *pool) {
 #ifdef HAS_C11_CONCURRENCY
-    threadpool_stop(pool);
+    check_err(mtx_lock(&pool->mutex));
+    atomic_store(&pool->shutdown, true);
+    check_err(cnd_broadcast(&pool->task_available));
+    check_err(mtx_unlock(&pool->mutex));
+
+    // The workers are detached, so completion is tracked by the thread count they decrement as
+    // they exit.
+    while (atomic_load(&pool->thread_count) > 0) {
+        thrd_yield();
+    }
+
     mtx_destroy(&pool->mutex);
     cnd_destroy(&pool->task_available);
+    cnd_destroy(&pool->inbox_space);
+    cnd_destroy(&pool->batch_finished);
+    free(pool->deques);
 #endif
 
     free(pool);
@@ -209,4 +424,4 @@ bool acnt_dec(struct AtomicCounter *counter) {
 #else
     return counter->count-- == 1;
 #endif
-}
\ No newline at end of file
+}
@@ -0,0 +1,79 @@
+// The monotonic clock is POSIX rather than ISO C, so ask for it before any header is included.
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <time.h>
+#include <timeman.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Returns the current reading of a millisecond clock.
+// Monotonic where the platform provides one (so the deadlines are immune to wall clock
+// adjustments), falling back to the C11 wall clock elsewhere.
+int64_t timeman_now_ms() {
+#if defined(_WIN32)
+    return (int64_t)GetTickCount64();
+#elif defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#else
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+// Starts timing a search with the given soft and hard limits (in milliseconds from now), clearing
+// the stop flag.
+void timeman_start(struct TimeManager *tm, int64_t soft_limit_ms, int64_t hard_limit_ms) {
+    tm->start_ms = timeman_now_ms();
+    tm->soft_deadline_ms = tm->start_ms + soft_limit_ms;
+    tm->hard_deadline_ms = tm->start_ms + hard_limit_ms;
+#ifdef HAS_C11_CONCURRENCY
+    atomic_store_explicit(&tm->stop, false, memory_order_relaxed);
+#else
+    tm->stop = false;
+#endif
+}
+
+// Moves the deadlines of a running search to the given limits measured from now, leaving the
+// stop flag untouched. Used on a ponder hit, where the speculative search becomes the real
+// search and its effectively unlimited budget must shrink to the normal per-move budget.
+// The workers read the deadlines without synchronisation, but only ever compare them against the
+// clock, so the worst a torn read can do is delay one worker's deadline by one check interval.
+void timeman_rearm(struct TimeManager *tm, int64_t soft_limit_ms, int64_t hard_limit_ms) {
+    tm->start_ms = timeman_now_ms();
+    tm->soft_deadline_ms = tm->start_ms + soft_limit_ms;
+    tm->hard_deadline_ms = tm->start_ms + hard_limit_ms;
+}
+
+// Returns the milliseconds elapsed since timeman_start.
+int64_t timeman_elapsed_ms(const struct TimeManager *tm) { return timeman_now_ms() - tm->start_ms; }
+
+// Returns whether the soft deadline has passed.
+bool timeman_soft_expired(const struct TimeManager *tm) { return timeman_now_ms() >= tm->soft_deadline_ms; }
+
+// Returns whether the hard deadline has passed.
+bool timeman_hard_expired(const struct TimeManager *tm) { return timeman_now_ms() >= tm->hard_deadline_ms; }
+
+// Sets the stop flag. Thread safe.
+void timeman_stop(struct TimeManager *tm) {
+#ifdef HAS_C11_CONCURRENCY
+    atomic_store_explicit(&tm->stop, true, memory_order_relaxed);
+#else
+    tm->stop = true;
+#endif
+}
+
+// Returns whether the stop flag is set. Thread safe, a single relaxed atomic load.
+bool timeman_stopped(struct TimeManager *tm) {
+#ifdef HAS_C11_CONCURRENCY
+    return atomic_load_explicit(&tm->stop, memory_order_relaxed);
+#else
+    return tm->stop;
+#endif
+}
@@ -1,114 +1,389 @@
 #include <assert.h>
 #include <config.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <threadpool.h>
 #include <tptable.h>
-#include <stdlib.h>
-
-// The hash table used to store the entries
-static struct TranspositionEntry tp_table[TRANSPOSITION_TABLE_SIZE] = {0};
-static ZobristHash protected_hash = 0;
+#include <util.h>
 
+// The transposition table is lock free. Each slot stores the entry packed into a single 64-bit
+// data word plus the entry's hash XORed with that data word. A probe recomputes (key ^ data) and
+// compares it with the probed hash, so an entry torn by a concurrent write fails the validation
+// and is treated as a miss instead of being returned (the standard lockless hashing scheme).
+// This removes the global mutex which serialised the search threads and the render thread on
+// every probe.
+//
+// All loads and stores are relaxed: the XOR validation makes torn entries safe, and a stale or
+// lost entry only costs a re-search.
+//
+// The table is an instance (struct TPTable), selected per thread; see default_table below.
+//
+// Slots are grouped into buckets of four sharing one index, so a hash collision no longer evicts
+// an entry outright. Each entry carries the generation of the search that wrote it (bumped by
+// tptable_new_search); replacement prefers empty slots, then the slot from the oldest search,
+// so entries from long-gone searches cannot squat on their slots for ever.
 #ifdef HAS_C11_CONCURRENCY
-static mtx_t tp_table_mutex;
+typedef _Atomic uint64_t TpWord;
+#else
+typedef uint64_t TpWord;
 #endif
 
+struct TranspositionSlot {
+    TpWord key;   // The entry hash XORed with `data`
+    TpWord data;  // The packed entry
+};
+
+// One bucket of slots sharing an index; sized to fill a single 64-byte cache line, so probing
+// the whole bucket costs the same memory traffic as probing one slot did.
+#define TPTABLE_BUCKET_SLOTS 4
+
+struct TranspositionBucket {
+    struct TranspositionSlot slots[TPTABLE_BUCKET_SLOTS];
+};
+
+// The current search generation wraps at the 6 bits the packed entry stores.
+#define GENERATION_MASK 0x3f
+
+// One transposition table instance. The bucket count is a power of two so the hash can be masked
+// into an index.
+struct TPTable {
+    struct TranspositionBucket *buckets;
+    size_t bucket_count;
+    uint8_t generation;
+};
+
+// The table the tptable_ functions operate on is selected per thread with tptable_select and
+// defaults to this shared instance, which tptable_init allocates. The GUI and UCI targets only
+// ever use the default; the self-play harness gives every concurrent game its own instances
+// (tptable_create) so the two configurations under test cannot read each other's entries.
+static struct TPTable default_table;
+
 #ifdef HAS_C11_CONCURRENCY
-static void check_err(int ret) {
-    if (ret != thrd_success) {
-        puts("tptable c11threads error");
-        exit(EXIT_FAILURE);
-    }
-}
+static _Thread_local struct TPTable *tls_table = NULL;
+#else
+static struct TPTable *tls_table = NULL;
 #endif
 
-void tptable_init() {
+static inline struct TPTable *current_table() { return tls_table != NULL ? tls_table : &default_table; }
+
+static inline uint64_t tp_load(TpWord *word) {
 #ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_init(&tp_table_mutex, mtx_plain));
+    return atomic_load_explicit(word, memory_order_relaxed);
+#else
+    return *word;
 #endif
 }
 
-void tptable_deinit() {
+static inline void tp_store(TpWord *word, uint64_t value) {
 #ifdef HAS_C11_CONCURRENCY
-    mtx_destroy(&tp_table_mutex);
+    atomic_store_explicit(word, value, memory_order_relaxed);
+#else
+    *word = value;
 #endif
 }
 
+// Pack a BoardPos into one byte (file in the high nibble, rank in the low nibble).
+// NULL_BOARDPOS ({0xf, 0xf}) packs to 0xff.
+static inline uint8_t pack_pos(struct BoardPos pos) {
+    return (uint8_t)((pos.file & 0xf) << 4 | (pos.rank & 0xf));
+}
+
+static inline struct BoardPos unpack_pos(uint8_t packed) {
+    return BoardPos((int8_t)((packed >> 4) & 0xf), (int8_t)(packed & 0xf));
+}
+
+// Pack an entry into a single 64-bit word: 32 bits of value, one byte each for the best move's
+// from and to positions, one byte of depth, then the entry type in the low 2 bits of the final
+// byte and the generation of the search that wrote the entry in the remaining 6.
+static uint64_t pack_entry(struct TranspositionEntry entry, uint8_t generation) {
+    uint64_t data = (uint32_t)entry.value;
+    data |= (uint64_t)pack_pos(entry.best_move.from) << 32;
+    data |= (uint64_t)pack_pos(entry.best_move.to) << 40;
+    data |= (uint64_t)(uint8_t)entry.depth << 48;
+    data |= (uint64_t)((uint8_t)entry.type | (uint8_t)(generation << 2)) << 56;
+    return data;
+}
+
+static struct TranspositionEntry unpack_entry(ZobristHash hash, uint64_t data) {
+    struct TranspositionEntry entry;
+    entry.hash = hash;
+    entry.value = (int)(int32_t)(data & 0xffffffff);
+    entry.best_move.from = unpack_pos((uint8_t)(data >> 32));
+    entry.best_move.to = unpack_pos((uint8_t)(data >> 40));
+    entry.depth = (char)(uint8_t)(data >> 48);
+    entry.type = (enum EntryType)((uint8_t)(data >> 56) & 0x3);
+    return entry;
+}
+
+// How many searches ago the packed entry was written, accounting for generation wrap-around.
+static inline int entry_age(uint64_t data, uint8_t generation) {
+    uint8_t entry_generation = (uint8_t)(data >> 58) & GENERATION_MASK;
+    return (generation - entry_generation) & GENERATION_MASK;
+}
+
+// Allocates a table's buckets with (approximately) the requested size in megabytes. The bucket
+// count is rounded down to a power of two, with a single-bucket minimum.
+static void table_alloc(struct TPTable *table, size_t size_mb) {
+    table->bucket_count = 1;
+    while (table->bucket_count * 2 * sizeof(struct TranspositionBucket) <= size_mb * 1024 * 1024) {
+        table->bucket_count *= 2;
+    }
+
+    table->buckets = calloc(table->bucket_count, sizeof(struct TranspositionBucket));
+    if (table->buckets == NULL) {
+        puts("error allocating transposition table");
+        exit(EXIT_FAILURE);
+    }
+
+    table->generation = 0;
+}
+
+// Allocates the shared default table, used by every thread which has not selected another.
+void tptable_init(size_t size_mb) { table_alloc(&default_table, size_mb); }
+
+void tptable_deinit() {
+    free(default_table.buckets);
+    default_table.buckets = NULL;
+    default_table.bucket_count = 0;
+}
+
+// Allocates an independent table instance. It is not selected; pass it to tptable_select on
+// every thread that should use it.
+struct TPTable *tptable_create(size_t size_mb) {
+    struct TPTable *table = malloc(sizeof(*table));
+    if (table == NULL) {
+        puts("error allocating transposition table");
+        exit(EXIT_FAILURE);
+    }
+    table_alloc(table, size_mb);
+    return table;
+}
+
+// Frees a table made with tptable_create. Threads still selecting it must select another (or
+// NULL, the default) first.
+void tptable_destroy(struct TPTable *table) {
+    free(table->buckets);
+    free(table);
+}
+
+// Selects the table the tptable_ functions use on the calling thread; NULL selects the shared
+// default table.
+void tptable_select(struct TPTable *table) { tls_table = table; }
+
+// Resizes the selected table, discarding all entries.
+// Must not be called while a search is running.
+void tptable_resize(size_t size_mb) {
+    struct TPTable *table = current_table();
+    free(table->buckets);
+    table_alloc(table, size_mb);
+}
+
+// Starts a new search generation. Called once per generate_move, so replacement can tell entries
+// of the current search apart from leftovers of earlier ones.
+void tptable_new_search() {
+    struct TPTable *table = current_table();
+    table->generation = (table->generation + 1) & GENERATION_MASK;
+}
+
 // Get a move from the transpoition table by a zobrist hash of the state
 // Returns a Move with NULL_BOARDPOS as the `from` and 0 as the depth if there is no move for the
 // specified hash
 struct TranspositionEntry tptable_get(ZobristHash hash) {
-#ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_lock(&tp_table_mutex));
-#endif
+    struct TPTable *table = current_table();
+    struct TranspositionBucket *bucket = &table->buckets[hash & (table->bucket_count - 1)];
 
-    struct TranspositionEntry t = tp_table[hash % TRANSPOSITION_TABLE_SIZE];
-    if (t.hash != hash) {
-        t = (struct TranspositionEntry){.best_move = (struct Move){NULL_BOARDPOS, NULL_BOARDPOS},
-                                        .depth = 0,
-                                        .hash = 0,
-                                        .type = EntryTypeExact,
-                                        .value = 0};
-    }
+    for (int i = 0; i < TPTABLE_BUCKET_SLOTS; i++) {
+        uint64_t key = tp_load(&bucket->slots[i].key);
+        uint64_t data = tp_load(&bucket->slots[i].data);
 
-#ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_unlock(&tp_table_mutex));
-#endif
+        // Empty slots, slots holding another hash and entries torn by a concurrent write all fail
+        // the XOR validation and are skipped.
+        if ((key ^ data) == hash) {
+            return unpack_entry(hash, data);
+        }
+    }
 
-    return t;
+    return (struct TranspositionEntry){.best_move = (struct Move){NULL_BOARDPOS, NULL_BOARDPOS},
+                                       .depth = 0,
+                                       .hash = 0,
+                                       .type = EntryTypeExact,
+                                       .value = 0};
 }
 
-// Put a move into the transposition table,
-// Replacing an existing move if this move is from a greater or equal `depth`, or if it adds a best move.
+// Put a move into the transposition table.
+// If the hash is already stored its slot is reused (replaced when the new entry is from a
+// greater or equal depth, refreshed to the current generation otherwise). New hashes take an
+// empty slot when the bucket has one, and otherwise replace the entry from the oldest search
+// generation, breaking ties by evicting the shallowest depth.
 void tptable_put(struct TranspositionEntry entry) {
-#ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_lock(&tp_table_mutex));
-#endif
+    struct TPTable *table = current_table();
+    struct TranspositionBucket *bucket = &table->buckets[entry.hash & (table->bucket_count - 1)];
+
+    struct TranspositionSlot *victim = NULL;
+    int victim_age = -1;
+    char victim_depth = 0;
+
+    for (int i = 0; i < TPTABLE_BUCKET_SLOTS; i++) {
+        struct TranspositionSlot *slot = &bucket->slots[i];
+        uint64_t prev_key = tp_load(&slot->key);
+        uint64_t prev_data = tp_load(&slot->data);
+
+        // Another thread may race this read-then-write, which at worst loses one entry - the XOR
+        // validation keeps probes safe regardless.
+        if (prev_data == 0 && prev_key == 0) {
+            // An empty slot; only used if the hash is not in a later slot of the bucket.
+            if (victim_age < INT32_MAX) {
+                victim = slot;
+                victim_age = INT32_MAX;
+            }
+            continue;
+        }
+
+        if ((prev_key ^ prev_data) == entry.hash) {
+            char prev_depth = (char)(uint8_t)(prev_data >> 48);
 
-    struct TranspositionEntry prev = tp_table[entry.hash % TRANSPOSITION_TABLE_SIZE];
-    if ((prev.hash != protected_hash && entry.hash != prev.hash) ||
-        (prev.hash == entry.hash && prev.depth <= entry.depth)) {
-        tp_table[entry.hash % TRANSPOSITION_TABLE_SIZE] = entry;
+            if (entry.depth >= prev_depth) {
+                uint64_t data = pack_entry(entry, table->generation);
+                tp_store(&slot->data, data);
+                tp_store(&slot->key, entry.hash ^ data);
+            } else {
+                // Keep the deeper entry, but stamp it with the current generation so the ongoing
+                // search does not age its own most useful entries out.
+                uint64_t data = pack_entry(unpack_entry(entry.hash, prev_data), table->generation);
+                tp_store(&slot->data, data);
+                tp_store(&slot->key, entry.hash ^ data);
+            }
+            return;
+        }
+
+        int age = entry_age(prev_data, table->generation);
+        char depth = (char)(uint8_t)(prev_data >> 48);
+        if (age > victim_age || (age == victim_age && depth < victim_depth)) {
+            victim = slot;
+            victim_age = age;
+            victim_depth = depth;
+        }
     }
 
-#ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_unlock(&tp_table_mutex));
-#endif
+    uint64_t data = pack_entry(entry, table->generation);
+    tp_store(&victim->data, data);
+    tp_store(&victim->key, entry.hash ^ data);
 }
 
-// Clears all entries from the transposition table
-void tptable_clear() {
-#ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_lock(&tp_table_mutex));
-#endif
+// The cache file format: a small header followed by the raw bucket array, so a file saved from
+// a table of the same size loads with pure sequential reads (and is mmap-able by external
+// tooling - the slots are plain little-endian word pairs at fixed offsets). Entries stay valid
+// across runs and across engine versions because positions are keyed by the fixed
+// Polyglot-compatible Zobrist scheme (zobrist.c); a file saved from a differently sized table
+// still loads, entry by entry, through the normal replacement policy.
+#define TPTABLE_FILE_MAGIC "chessTT1"
 
-    memset((void*)tp_table, 0, TRANSPOSITION_TABLE_SIZE * sizeof(struct TranspositionEntry));
+struct TPTableFileHeader {
+    char magic[8];          // TPTABLE_FILE_MAGIC, which doubles as the format version
+    uint64_t bucket_count;  // Bucket count of the table the file was saved from
+    uint64_t generation;    // Its generation counter, restored on a same-size load
+};
 
-#ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_unlock(&tp_table_mutex));
-#endif
+// A plain (non-atomic) image of one bucket, the unit the save/load loops stream through so the
+// file I/O works on ordinary memory and the table is only touched word by word.
+struct BucketImage {
+    uint64_t words[TPTABLE_BUCKET_SLOTS * 2];  // key, data pairs
+};
+
+// The number of buckets read or written per fread/fwrite call.
+#define TPTABLE_IO_CHUNK_BUCKETS 4096
+
+// Saves the selected table's entries to `path`, returning false if the file cannot be written.
+// Must not be called while a search is running (a concurrent writer would not corrupt the file -
+// the XOR validation travels with each entry - but its entries may be half missing).
+bool tptable_save(const char *path) {
+    struct TPTable *table = current_table();
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) return false;
+
+    struct TPTableFileHeader header;
+    memcpy(header.magic, TPTABLE_FILE_MAGIC, sizeof(header.magic));
+    header.bucket_count = table->bucket_count;
+    header.generation = table->generation;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    static struct BucketImage chunk[TPTABLE_IO_CHUNK_BUCKETS];
+    size_t filled = 0;
+    for (size_t i = 0; ok && i < table->bucket_count; i++) {
+        for (int s = 0; s < TPTABLE_BUCKET_SLOTS; s++) {
+            chunk[filled].words[s * 2] = tp_load(&table->buckets[i].slots[s].key);
+            chunk[filled].words[s * 2 + 1] = tp_load(&table->buckets[i].slots[s].data);
+        }
+        filled++;
+
+        if (filled == TPTABLE_IO_CHUNK_BUCKETS || i == table->bucket_count - 1) {
+            ok = fwrite(chunk, sizeof(chunk[0]), filled, file) == filled;
+            filled = 0;
+        }
+    }
+
+    return fclose(file) == 0 && ok;
 }
 
-// The entry for a protected hash can only be replaced by an entry with the same hash.
-// Usually if (hash % TRANSPOSITION_TABLE_SIZE) is the same for two hashes one will replace the other.
-// If the entry for hash has another hash in it the entry will be reset with the inputted hash.
-void tptable_set_protected_hash(ZobristHash hash) {
-#ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_lock(&tp_table_mutex));
-#endif
+// Loads a cache file saved with tptable_save into the selected table, returning false if the
+// file cannot be read or is not a cache file. A file from a same-size table loads straight into
+// the buckets; any other size is re-inserted entry by entry through tptable_put, so a cache can
+// be carried across a Hash setting change (at the cost of dropping entries that no longer fit).
+// Must not be called while a search is running.
+bool tptable_load(const char *path) {
+    struct TPTable *table = current_table();
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
 
-    protected_hash = hash;
-    struct TranspositionEntry entry = tp_table[hash % TRANSPOSITION_TABLE_SIZE];
-    if (entry.hash != hash) {
-        entry.hash = hash;
-        entry.depth = 0;
-        entry.value = 0;
-        entry.best_move = (struct Move){NULL_BOARDPOS, NULL_BOARDPOS};
-        tp_table[hash % TRANSPOSITION_TABLE_SIZE] = entry;
+    struct TPTableFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TPTABLE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        fclose(file);
+        return false;
     }
 
-#ifdef HAS_C11_CONCURRENCY
-    check_err(mtx_unlock(&tp_table_mutex));
-#endif
-}
\ No newline at end of file
+    bool same_size = header.bucket_count == table->bucket_count;
+    bool ok = true;
+
+    static struct BucketImage chunk[TPTABLE_IO_CHUNK_BUCKETS];
+    size_t bucket = 0;
+    while (ok && bucket < header.bucket_count) {
+        size_t wanted = MIN(header.bucket_count - bucket, (size_t)TPTABLE_IO_CHUNK_BUCKETS);
+        ok = fread(chunk, sizeof(chunk[0]), wanted, file) == wanted;
+
+        for (size_t i = 0; ok && i < wanted; i++, bucket++) {
+            for (int s = 0; s < TPTABLE_BUCKET_SLOTS; s++) {
+                uint64_t key = chunk[i].words[s * 2];
+                uint64_t data = chunk[i].words[s * 2 + 1];
+
+                if (same_size) {
+                    tp_store(&table->buckets[bucket].slots[s].key, key);
+                    tp_store(&table->buckets[bucket].slots[s].data, data);
+                } else if ((key | data) != 0) {
+                    // The slot's hash is recovered from the XOR validation scheme itself.
+                    tptable_put(unpack_entry(key ^ data, data));
+                }
+            }
+        }
+    }
+
+    if (ok && same_size) table->generation = (uint8_t)(header.generation & GENERATION_MASK);
+
+    fclose(file);
+    return ok;
+}
+
+// Clears all entries from the selected transposition table
+void tptable_clear() {
+    struct TPTable *table = current_table();
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        for (int s = 0; s < TPTABLE_BUCKET_SLOTS; s++) {
+            tp_store(&table->buckets[i].slots[s].key, 0);
+            tp_store(&table->buckets[i].slots[s].data, 0);
+        }
+    }
+}
@@ -0,0 +1,261 @@
+// The main function for the headless chess-uci target, speaking the UCI protocol over
+// stdin/stdout. Unlike the GUI target this links no graphics libraries and starts instantly, so
+// the engine can run on servers and under match runners such as cutechess-cli.
+// Only the parts of UCI the engine needs are implemented: uci, isready, ucinewgame,
+// position (startpos or fen, with a move list) and go (with an optional movetime).
+// Two commands outside the protocol, bench and epd, run the offline drivers in bench.c.
+// https://www.chessprogramming.org/UCI
+
+#include <bench.h>
+#include <bitboard.h>
+#include <chess.h>
+#include <config.h>
+#include <engine.h>
+#include <fen.h>
+#include <inttypes.h>
+#include <kpk.h>
+#include <limits.h>
+#include <openings.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threadpool.h>
+#include <timeman.h>
+#include <tptable.h>
+#include <util.h>
+#include <zobrist.h>
+
+#define UCI_LINE_MAX 4096
+
+static const char *START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Parses an algebraic square such as "e4" into a BoardPos.
+// Algebraic ranks count from white's side of the board, BoardPos ranks from black's.
+static bool parse_uci_square(const char *str, struct BoardPos *pos) {
+    if (str[0] < 'a' || str[0] > 'h' || str[1] < '1' || str[1] > '8') return false;
+    *pos = BoardPos(str[0] - 'a', 8 - (str[1] - '0'));
+    return true;
+}
+
+// Parses a UCI move such as "e2e4" or "e7e8q". A promotion suffix is accepted but not stored:
+// make_move always promotes to a queen.
+static bool parse_uci_move(const char *str, struct Move *move) {
+    size_t len = strlen(str);
+    if (len != 4 && len != 5) return false;
+    return parse_uci_square(str, &move->from) && parse_uci_square(str + 2, &move->to);
+}
+
+// Writes a move in UCI notation to `out`, which must hold at least 6 chars. A queen promotion
+// suffix is added when a pawn moves to the final rank.
+static void format_uci_move(struct GameState *state, struct Move move, char *out) {
+    bool promotion = get_piece(state, move.from).type == Pawn && (move.to.rank == 0 || move.to.rank == 7);
+    *out++ = 'a' + move.from.file;
+    *out++ = '0' + (8 - move.from.rank);
+    *out++ = 'a' + move.to.file;
+    *out++ = '0' + (8 - move.to.rank);
+    if (promotion) *out++ = 'q';
+    *out = '\0';
+}
+
+// Handles a "position" command: "position startpos|fen <fen> [moves <move>...]".
+// Replaces `*state` with the parsed position; on a parse error the previous state is kept.
+static void handle_position(struct GameState **state, char *args) {
+    struct GameState *new_state = NULL;
+    char *moves = strstr(args, "moves");
+
+    if (strncmp(args, "startpos", strlen("startpos")) == 0) {
+        new_state = fen_to_gamestate(START_FEN);
+    } else if (strncmp(args, "fen ", strlen("fen ")) == 0) {
+        // The FEN string runs from after "fen " to the "moves" keyword (or the end of the line).
+        char *fen = args + strlen("fen ");
+        if (moves > fen) moves[-1] = '\0';
+        new_state = fen_to_gamestate(fen);
+    }
+
+    if (new_state == NULL) {
+        printf("info string invalid position\n");
+        return;
+    }
+
+    // Apply the move list, if any.
+    if (moves != NULL) {
+        for (char *move_str = strtok(moves + strlen("moves"), " "); move_str != NULL;
+             move_str = strtok(NULL, " ")) {
+            struct Move move;
+            if (!parse_uci_move(move_str, &move) || !is_move_legal(new_state, move)) {
+                printf("info string invalid move %s\n", move_str);
+                deinit_gamestate(new_state);
+                return;
+            }
+            make_move(new_state, move, true);
+        }
+    }
+
+    if (*state != NULL) deinit_gamestate(*state);
+    *state = new_state;
+}
+
+// Handles a "go" command: searches the current position and prints the best move.
+// "go movetime <ms>" searches for exactly that long; any other arguments use the default budget.
+static void handle_go(struct GameState *state, struct ThreadPool *pool, char *args) {
+    int64_t soft_ms = MOVEGEN_SOFT_TIME_MS;
+    int64_t hard_ms = MOVEGEN_HARD_TIME_MS;
+
+    char *movetime = strstr(args, "movetime ");
+    if (movetime != NULL) {
+        int64_t ms = atoll(movetime + strlen("movetime "));
+        if (ms > 0) {
+            soft_ms = ms;
+            hard_ms = ms;
+        }
+    }
+
+    // The search workers are submitted under a batch and waited for, rather than polling the
+    // stop flag: the hard deadline can set the flag while workers are still unwinding (and still
+    // reading `tm`), and the next `go` reuses this stack slot. The batch only completes once
+    // every worker has exited. Without C11 threads generate_move_timed runs synchronously and
+    // the wait returns immediately.
+    struct TimeManager tm;
+    struct TaskBatch batch;
+    taskbatch_init(&batch);
+    generate_move_timed(state, pool, &tm, soft_ms, hard_ms, &batch);
+    threadpool_wait(pool, &batch);
+
+    // The finished search published its result to the completion mailbox.
+    struct SearchResult result;
+    bool have_result = search_result_get(state->hash, &result);
+
+    // If no iteration completed inside the time budget there is no published result; fall back
+    // to the first legal move rather than forfeiting.
+    if (!have_result) {
+        result.value = 0;
+        result.depth = 0;
+        result.best_move = (struct Move){NULL_BOARDPOS, NULL_BOARDPOS};
+        for (int from = 0; from < 64 && boardpos_eq(result.best_move.from, NULL_BOARDPOS); from++) {
+            for (int to = 0; to < 64; to++) {
+                struct Move move = {BoardPos(from % 8, from / 8), BoardPos(to % 8, to / 8)};
+                if (is_move_legal(state, move)) {
+                    result.best_move = move;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (boardpos_eq(result.best_move.from, NULL_BOARDPOS)) {
+        printf("bestmove 0000\n");
+    } else {
+        // Report the totals of the finished search: the standard info fields, plus an info string
+        // with the diagnostic ratios (qsearch share of the tree, transposition table hit and
+        // cutoff rates, and how often a fail-high came from the first move searched, which
+        // measures move ordering quality).
+        struct SearchStats stats = search_stats_get();
+        uint64_t all_nodes = stats.nodes + stats.qnodes;
+        // The time manager's clock, not the stats stamp: the stats only record the elapsed time
+        // once the main worker has fully unwound, which can be after a hard-deadline abort
+        // releases this thread.
+        int64_t elapsed_ms = MAX(timeman_elapsed_ms(&tm), 1);
+
+        char move_str[6];
+        format_uci_move(state, result.best_move, move_str);
+        printf("info depth %d score cp %d time %lld nodes %" PRIu64 " nps %" PRIu64 "\n",
+               result.depth == CHAR_MAX ? 0 : result.depth, result.value, (long long)timeman_elapsed_ms(&tm),
+               all_nodes, all_nodes * 1000 / (uint64_t)elapsed_ms);
+        if (all_nodes > 0) {
+            printf("info string qnodes %.1f%% tthits %.1f%% ttcuts %.1f%% firstcut %.1f%%\n",
+                   100.0 * (double)stats.qnodes / (double)all_nodes,
+                   100.0 * (double)stats.tt_hits / (double)(stats.tt_probes > 0 ? stats.tt_probes : 1),
+                   100.0 * (double)stats.tt_cutoffs / (double)(stats.tt_probes > 0 ? stats.tt_probes : 1),
+                   100.0 * (double)stats.beta_cutoffs_first /
+                       (double)(stats.beta_cutoffs > 0 ? stats.beta_cutoffs : 1));
+        }
+        printf("bestmove %s\n", move_str);
+    }
+}
+
+int main() {
+    // Line buffer stdout even when piped, so the GUI driving the engine sees responses promptly.
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    init_opening_book();
+    bitboard_init();
+    kpk_init();
+    tptable_init(TPTABLE_DEFAULT_MB);
+
+    // With CHESS_TT_FILE set the transposition table persists across sessions: it is loaded
+    // here and saved back on a clean exit, so analysis accumulates from day to day instead of
+    // being re-searched from scratch. ttsave/ttload do the same on demand.
+    const char *tt_file = getenv("CHESS_TT_FILE");
+    if (tt_file != NULL && tptable_load(tt_file)) {
+        printf("info string loaded transposition table from %s\n", tt_file);
+    }
+
+    struct ThreadPool *pool = threadpool_init();
+    struct GameState *state = fen_to_gamestate(START_FEN);
+
+    char line[UCI_LINE_MAX];
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (strcmp(line, "uci") == 0) {
+            printf("id name chess\n");
+            printf("id author camc\n");
+            printf("option name Hash type spin default %d min 1 max 65536\n", TPTABLE_DEFAULT_MB);
+            printf("uciok\n");
+        } else if (strncmp(line, "setoption ", strlen("setoption ")) == 0) {
+            // Only the Hash option (transposition table size in MB) is supported.
+            if (strstr(line, "name Hash") != NULL) {
+                char *value = strstr(line, "value ");
+                long mb = value != NULL ? atol(value + strlen("value ")) : 0;
+                if (mb >= 1 && mb <= 65536) {
+                    tptable_resize(mb);
+                } else {
+                    printf("info string invalid Hash value\n");
+                }
+            }
+        } else if (strcmp(line, "isready") == 0) {
+            printf("readyok\n");
+        } else if (strcmp(line, "ucinewgame") == 0) {
+            tptable_clear();
+        } else if (strncmp(line, "position ", strlen("position ")) == 0) {
+            handle_position(&state, line + strlen("position "));
+        } else if (strncmp(line, "go", strlen("go")) == 0) {
+            handle_go(state, pool, line + strlen("go"));
+        } else if (strncmp(line, "bench", strlen("bench")) == 0) {
+            // "bench [depth]": deterministic fixed-depth benchmark, printing a node count
+            // signature. Not part of UCI; used to gate performance changes (see bench.c).
+            bench_run(atoi(line + strlen("bench")));
+        } else if (strncmp(line, "epd ", strlen("epd ")) == 0) {
+            // "epd <file> [depth]": run an EPD best-move test suite. Also not part of UCI.
+            char *path = strtok(line + strlen("epd "), " ");
+            char *depth_str = strtok(NULL, " ");
+            if (path == NULL || !epd_run(path, depth_str != NULL ? atoi(depth_str) : 0)) {
+                printf("info string cannot open epd file\n");
+            }
+        } else if (strncmp(line, "ttsave ", strlen("ttsave ")) == 0) {
+            // "ttsave/ttload <file>": persist or restore the transposition table, so analysis
+            // accumulates across sessions (see tptable_save). Also not part of UCI.
+            printf("info string %s\n", tptable_save(line + strlen("ttsave ")) ? "table saved"
+                                                                              : "cannot save table");
+        } else if (strncmp(line, "ttload ", strlen("ttload ")) == 0) {
+            printf("info string %s\n", tptable_load(line + strlen("ttload ")) ? "table loaded"
+                                                                              : "cannot load table");
+        } else if (strcmp(line, "quit") == 0) {
+            break;
+        }
+        // Unknown commands are ignored, as the protocol requires.
+    }
+
+    deinit_gamestate(state);
+    threadpool_deinit(pool);
+
+    if (tt_file != NULL && !tptable_save(tt_file)) {
+        printf("info string cannot save transposition table to %s\n", tt_file);
+    }
+
+    tptable_deinit();
+    deinit_opening_book();
+
+    return EXIT_SUCCESS;
+}
@@ -112,6 +112,35 @@ void draw_ui() {
         GuiLabel((Rectangle){BOARD_SIZE + 5, 60, WINDOW_WIDTH - BOARD_SIZE, 30}, label);
     }
 
+#ifdef DEBUG_SETTINGS_ENABLED
+    // Draw the search statistics overlay (toggled with the S debug key), showing the totals of
+    // the last completed search: tree size and speed, the qsearch share of the tree, the
+    // transposition table hit/cutoff rates and the first-move beta-cutoff rate (move ordering
+    // quality).
+    if (frontend_state.debug_show_search_stats) {
+        struct SearchStats stats = search_stats_get();
+        uint64_t all_nodes = stats.nodes + stats.qnodes;
+        int64_t elapsed_ms = stats.elapsed_ms > 0 ? stats.elapsed_ms : 1;
+
+        char lines[5][64];
+        snprintf(lines[0], sizeof(lines[0]), "depth %d in %lld ms", stats.depth, (long long)stats.elapsed_ms);
+        snprintf(lines[1], sizeof(lines[1]), "nodes %llu (%.0f knps)", (unsigned long long)all_nodes,
+                 (double)all_nodes / (double)elapsed_ms);
+        snprintf(lines[2], sizeof(lines[2]), "qsearch %.1f%%",
+                 all_nodes > 0 ? 100.0 * (double)stats.qnodes / (double)all_nodes : 0.0);
+        snprintf(lines[3], sizeof(lines[3]), "tt hits %.1f%% cuts %.1f%%",
+                 stats.tt_probes > 0 ? 100.0 * (double)stats.tt_hits / (double)stats.tt_probes : 0.0,
+                 stats.tt_probes > 0 ? 100.0 * (double)stats.tt_cutoffs / (double)stats.tt_probes : 0.0);
+        snprintf(lines[4], sizeof(lines[4]), "first-move cutoffs %.1f%%",
+                 stats.beta_cutoffs > 0 ? 100.0 * (double)stats.beta_cutoffs_first / (double)stats.beta_cutoffs : 0.0);
+
+        DrawRectangle(5, 5, 210, 5 * 18 + 10, Fade(BLACK, 0.7f));
+        for (int i = 0; i < 5; i++) {
+            DrawText(lines[i], 10, 10 + i * 18, 10, RAYWHITE);
+        }
+    }
+#endif
+
     // Draw a message box if there is a message
     if (frontend_state.message_box != NULL) {
         if (GuiMessageBox((Rectangle){WINDOW_WIDTH / 5, WINDOW_HEIGHT / 4, (WINDOW_WIDTH * 3) / 5, WINDOW_HEIGHT / 2},
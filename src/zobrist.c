@@ -9,44 +9,41 @@ static inline int piece_to_polyglot(struct Piece piece) {
     return 2 * (6 - piece.type) + (piece.player == WhitePlayer ? 1 : 0);
 }
 
-// Compute the Zobrist hash of a GameState.
-ZobristHash hash_state(struct GameState *state) {
-    // Constants used to index the Zobrist randoms.
-    static const int PIECES = 0;
-    static const int WHITE_TO_MOVE = 780;
-    static const int WHITE_CASTLERT_RIGHT = 768;
-    static const int WHITE_CASTLERT_LEFT = 769;
-    static const int BLACK_CASTLERT_RIGHT = 770;
-    static const int BLACK_CASTLERT_LEFT = 771;
-    static const int ENPASSANT = 772;
+// Constants used to index the Zobrist randoms.
+static const int PIECES = 0;
+static const int WHITE_TO_MOVE = 780;
+static const int WHITE_CASTLERT_RIGHT = 768;
+static const int WHITE_CASTLERT_LEFT = 769;
+static const int BLACK_CASTLERT_RIGHT = 770;
+static const int BLACK_CASTLERT_LEFT = 771;
+static const int ENPASSANT = 772;
 
-    ZobristHash hash = 0;
+// XOR a piece at a position in or out of a hash.
+// Used by make_move to update the hash incrementally instead of rehashing the whole state.
+ZobristHash zobrist_toggle_piece(ZobristHash hash, struct Piece piece, struct BoardPos pos) {
+    return hash ^ ZOBRIST_RANDOMS[PIECES + 64 * piece_to_polyglot(piece) + 8 * (7 - pos.rank) + pos.file];
+}
 
-    // Add pieces to hash
-    for (int i = 0; i < 16; i++) {
-        if (!boardpos_eq(state->piece_list_white[i], NULL_BOARDPOS)) {
-            struct BoardPos pos = state->piece_list_white[i];
-            struct Piece p = get_piece(state, pos);
-            hash ^= ZOBRIST_RANDOMS[PIECES + 64 * piece_to_polyglot(p) + 8 * (7 - pos.rank) + pos.file];
-        }
+// XOR the side-to-move key in or out of a hash.
+ZobristHash zobrist_toggle_white_to_move(ZobristHash hash) { return hash ^ ZOBRIST_RANDOMS[WHITE_TO_MOVE]; }
 
-        if (!boardpos_eq(state->piece_list_black[i], NULL_BOARDPOS)) {
-            struct BoardPos pos = state->piece_list_black[i];
-            struct Piece p = get_piece(state, pos);
-            hash ^= ZOBRIST_RANDOMS[PIECES + 64 * piece_to_polyglot(p) + 8 * (7 - pos.rank) + pos.file];
-        }
+// XOR a castling right key in or out of a hash, where `left` means the rook at file=0.
+ZobristHash zobrist_toggle_castlert(ZobristHash hash, enum Player player, bool left) {
+    if (player == WhitePlayer) {
+        return hash ^ ZOBRIST_RANDOMS[left ? WHITE_CASTLERT_LEFT : WHITE_CASTLERT_RIGHT];
+    } else {
+        return hash ^ ZOBRIST_RANDOMS[left ? BLACK_CASTLERT_LEFT : BLACK_CASTLERT_RIGHT];
     }
+}
 
-    // Add side to move
-    if (state->white_to_move) hash ^= ZOBRIST_RANDOMS[WHITE_TO_MOVE];
-
-    // Add castling rights
-    if (state->white_castlert_right) hash ^= ZOBRIST_RANDOMS[WHITE_CASTLERT_RIGHT];
-    if (state->white_castlert_left) hash ^= ZOBRIST_RANDOMS[WHITE_CASTLERT_LEFT];
-    if (state->black_castlert_right) hash ^= ZOBRIST_RANDOMS[BLACK_CASTLERT_RIGHT];
-    if (state->black_castlert_left) hash ^= ZOBRIST_RANDOMS[BLACK_CASTLERT_LEFT];
+// Returns the en passant contribution of a state's hash (zero or a single en passant file key).
+// In the polyglot format the key is only included when the player to move actually has a pawn next
+// to the pawn which just double pushed, so this part of the hash depends on the surrounding board
+// and cannot be updated with a simple per-move XOR. make_move XORs this contribution out before a
+// move is applied and XORs the new contribution back in afterwards.
+ZobristHash zobrist_enpassant_part(struct GameState *state) {
+    ZobristHash hash = 0;
 
-    // Add en passant file
     enum Player to_move = state->white_to_move ? WhitePlayer : BlackPlayer;
     int enp_file = get_enpassant_target_file(state, to_move);
     int enp_rank = state->white_to_move ? 3 : 4;
@@ -75,6 +72,42 @@ ZobristHash hash_state(struct GameState *state) {
     return hash;
 }
 
+// Compute the Zobrist hash of a GameState from scratch.
+// make_move keeps hashes up to date incrementally; this full rehash is retained for initialising
+// states and as a debug cross-check of the incremental updates.
+ZobristHash hash_state(struct GameState *state) {
+    ZobristHash hash = 0;
+
+    // Add pieces to hash
+    for (int i = 0; i < 16; i++) {
+        if (!boardpos_eq(state->piece_list_white[i], NULL_BOARDPOS)) {
+            struct BoardPos pos = state->piece_list_white[i];
+            struct Piece p = get_piece(state, pos);
+            hash ^= ZOBRIST_RANDOMS[PIECES + 64 * piece_to_polyglot(p) + 8 * (7 - pos.rank) + pos.file];
+        }
+
+        if (!boardpos_eq(state->piece_list_black[i], NULL_BOARDPOS)) {
+            struct BoardPos pos = state->piece_list_black[i];
+            struct Piece p = get_piece(state, pos);
+            hash ^= ZOBRIST_RANDOMS[PIECES + 64 * piece_to_polyglot(p) + 8 * (7 - pos.rank) + pos.file];
+        }
+    }
+
+    // Add side to move
+    if (state->white_to_move) hash ^= ZOBRIST_RANDOMS[WHITE_TO_MOVE];
+
+    // Add castling rights
+    if (state->white_castlert_right) hash ^= ZOBRIST_RANDOMS[WHITE_CASTLERT_RIGHT];
+    if (state->white_castlert_left) hash ^= ZOBRIST_RANDOMS[WHITE_CASTLERT_LEFT];
+    if (state->black_castlert_right) hash ^= ZOBRIST_RANDOMS[BLACK_CASTLERT_RIGHT];
+    if (state->black_castlert_left) hash ^= ZOBRIST_RANDOMS[BLACK_CASTLERT_LEFT];
+
+    // Add en passant file
+    hash ^= zobrist_enpassant_part(state);
+
+    return hash;
+}
+
 // clang-format off
 // polyglot format zobrist hashes
 // https://www.chessprogramming.org/Zobrist_Hashing